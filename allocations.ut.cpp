@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#define YALL_COUNT_ALLOCATIONS
+#include "yall/allocations.hpp"
+#include "yall/backends.hpp"
+#include "yall/logger.hpp"
+
+namespace {
+
+struct YallLoggerAllocationsShould: public ::testing::Test {
+  YallLoggerAllocationsShould():
+    backend(std::make_shared<::yall::NullBackend>()),
+    eager(backend),
+    deferred(backend, ::yall::Capture::Deferred),
+    longText(100, 'x') {
+    // First use interns the type tags and leaves a recycled message in the pool.
+    eager.log("warm", 1, longText);
+    eager() << "warm" << 1;
+    deferred.log(MakeFmt("${1} ${2} ${3}"), 1, 2, 3);
+  }
+  std::shared_ptr<::yall::NullBackend> backend;
+  ::yall::Logger eager;
+  ::yall::Logger deferred;
+  std::string longText;
+};
+
+TEST_F(YallLoggerAllocationsShould, NotAllocateForShortFields) {
+  ::yall::testing::AllocationCounter counter;
+  eager.log("x");
+  eager() << "x" << 1;
+  EXPECT_EQ(0, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, KeepTypicalStreamedMessagesInline) {
+  ::yall::testing::AllocationCounter counter;
+  eager() << "Result is " << 10 << ::yall::Priority::Warning;
+  deferred() << "a" << 1 << 'b' << 2.5 << "c" << 3u << "d" << 4;
+  EXPECT_EQ(0, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, NotCopyTheMessageOnTheWayToTheBackend) {
+  ::yall::testing::AllocationCounter counter;
+  eager.log(longText);
+  // The copy of the long string, the sequence is inline.
+  EXPECT_EQ(1, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, MoveRvalueStringsIntoTheMessage) {
+  std::string moved(longText);
+  ::yall::testing::AllocationCounter counter;
+  eager.log(std::move(moved));
+  EXPECT_EQ(0, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, MoveRvalueStringsFromTheStream) {
+  std::string moved(longText);
+  ::yall::testing::AllocationCounter counter;
+  eager() << std::move(moved);
+  EXPECT_EQ(0, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, NotCopyTheMessageThroughFanOutWithOneChild) {
+  ::yall::Logger fanned(std::make_shared<::yall::FanOutBackend>(
+    std::initializer_list<std::shared_ptr<::yall::LoggerBackend>>{backend}));
+  fanned.log("warm");
+  ::yall::testing::AllocationCounter counter;
+  fanned.log("x");
+  EXPECT_EQ(0, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, NotAllocateForLayoutFields) {
+  const ::yall::Layout layout("%d %t <%i> %p %m", ::yall::TimeStampFormatter::utc());
+  ::yall::LoggerMessage msg;
+  msg.meta.threadId = std::this_thread::get_id();
+  msg.meta.setPriority(::yall::Priority::Info);
+  msg.sequence.emplace_back(::yall::TypeAndValue{"test", "value"});
+  std::string out;
+  out.reserve(256);
+
+  ::yall::testing::AllocationCounter counter;
+  layout.append(out, msg);
+  EXPECT_EQ(0, counter.count());
+}
+
+TEST_F(YallLoggerAllocationsShould, NotAllocateForDeferredNumbers) {
+  ::yall::testing::AllocationCounter counter;
+  deferred.log(MakeFmt("${1} ${2} ${3}"), 12345678901234ll, 3.14, 'c');
+  EXPECT_EQ(0, counter.count());
+}
+
+}
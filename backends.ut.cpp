@@ -2,6 +2,12 @@
 
 #include "yall/backends.hpp"
 #include "yall/mocks.hpp"
+#include "yall/prefix.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace {
 
@@ -31,19 +37,65 @@ TEST_F(YallMetaFormattingBackendShould, ForwardFormattedToDecorated) {
     .Times(1).WillOnce(::testing::SaveArg<0>(&msg));;
 
   ::yall::LoggerMessage input;
-  input.meta["yall::TimeStamp"] = "<time>";
-  input.meta["yall::ThreadId"] = "<tid>";
-  input.meta["yall::Priority"] = "<priority>";
+  input.meta.timeStamp = std::chrono::system_clock::now();
+  input.meta.threadId = std::this_thread::get_id();
+  input.meta.setPriority(::yall::Priority::Warning);
   input.sequence.push_back(::yall::TypeAndValue{"test", "test value"});
 
   uut.take(::yall::LoggerMessage(input));
 
-  EXPECT_EQ(2, msg.sequence.size());
-  EXPECT_EQ("test value", msg.sequence[1].value);
+  ASSERT_EQ(1, msg.sequence.size());
   EXPECT_EQ("yall::Formatted", msg.sequence[0].type);
-  EXPECT_THAT(msg.sequence[0].value, ::testing::ContainsRegex("<time>"));
-  EXPECT_THAT(msg.sequence[0].value, ::testing::ContainsRegex("<tid>"));
-  EXPECT_THAT(msg.sequence[0].value, ::testing::ContainsRegex("<priority>"));
+  EXPECT_THAT(msg.sequence[0].value, ::testing::EndsWith("- test value"));
+  EXPECT_THAT(msg.sequence[0].value, ::testing::HasSubstr(::yall::toString(input.meta.timeStamp)));
+  EXPECT_THAT(msg.sequence[0].value, ::testing::HasSubstr("<" + ::yall::toString(input.meta.threadId) + ">"));
+  EXPECT_THAT(msg.sequence[0].value, ::testing::HasSubstr(" warning -"));
+}
+
+TEST_F(YallMetaFormattingBackendShould, LeaveMissingPriorityAndPrefixEmpty) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+
+  uut.take(::yall::LoggerMessage());
+
+  EXPECT_THAT(msg.sequence[0].value, ::testing::EndsWith(">          -- "));
+}
+
+TEST_F(YallMetaFormattingBackendShould, FollowCustomPattern) {
+  ::yall::MetaFormattingBackend localUut(decoratedMock, "[%-7p|%5n] %% %m!", ::yall::TimeStampFormatter::utc());
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+
+  ::yall::LoggerMessage input;
+  input.meta.setPriority(::yall::Priority::Info);
+  input.meta.prefix = ::yall::internPrefix("app");
+  input.sequence.push_back(::yall::TypeAndValue{"test", "value "});
+  input.sequence.emplace_back();
+  capture(input.sequence.back(), 42);
+  localUut.take(std::move(input));
+
+  ASSERT_EQ(1, msg.sequence.size());
+  EXPECT_EQ("[info   |  app] % value 42!", msg.sequence[0].value);
+}
+
+TEST_F(YallMetaFormattingBackendShould, SplitDateAndTime) {
+  ::yall::MetaFormattingBackend localUut(decoratedMock, "%t on %d", ::yall::TimeStampFormatter::utc());
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+
+  ::yall::LoggerMessage input;
+  input.meta.timeStamp = ::yall::TimeStamp(std::chrono::milliseconds(1234567891500));
+  localUut.take(std::move(input));
+
+  EXPECT_EQ("23:31:31.500 on 2009-02-13", msg.sequence[0].value);
+}
+
+TEST_F(YallMetaFormattingBackendShould, RejectUnknownDirectives) {
+  EXPECT_THROW(::yall::MetaFormattingBackend(decoratedMock, std::string("%q")), std::invalid_argument);
+  EXPECT_THROW(::yall::MetaFormattingBackend(decoratedMock, std::string("%-8")), std::invalid_argument);
 }
 
 struct YallStreamBackendShould: public ::testing::Test {
@@ -77,6 +129,16 @@ TEST_F(YallStreamBackendShould, ReceiveSequenceOnStream2) {
   EXPECT_EQ(output, "hello world!\n");
 }
 
+TEST_F(YallStreamBackendShould, RenderDeferredCaptures) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"type", "n="});
+  msg.sequence.emplace_back(yall::TypeAndValue{"type", ""});
+  capture(msg.sequence.back(), 42);
+
+  uut.take(::yall::LoggerMessage(msg));
+
+  EXPECT_EQ("n=42\n", testStream->str());
+}
 
 struct YallFanOutBackendShould: public ::testing::Test {
   YallFanOutBackendShould():
@@ -115,6 +177,96 @@ TEST_F(YallFanOutBackendShould, ForwardToAllAdded) {
 }
 
 
+struct SharedReadingBackend: public ::yall::LoggerBackend {
+  void take(::yall::LoggerMessage&&) override {
+    ++copies;
+  }
+  void takeShared(const ::yall::SharedMessage& msg) override {
+    seen = msg.get();
+    size = msg->sequence.size();
+  }
+  const ::yall::LoggerMessage* seen = nullptr;
+  size_t size = 0;
+  int copies = 0;
+};
+
+TEST_F(YallFanOutBackendShould, ShareOneMessageBetweenReadingChildren) {
+  auto first = std::make_shared<SharedReadingBackend>();
+  auto second = std::make_shared<SharedReadingBackend>();
+  auto third = std::make_shared<SharedReadingBackend>();
+  ::yall::FanOutBackend localUut{first, second, third};
+
+  localUut.take(::yall::LoggerMessage());
+
+  EXPECT_NE(nullptr, first->seen);
+  EXPECT_EQ(first->seen, second->seen);
+  EXPECT_EQ(0, first->copies + second->copies);
+}
+
+TEST_F(YallFanOutBackendShould, CopyOnlyForModifyingChildren) {
+  auto reader = std::make_shared<SharedReadingBackend>();
+  ::yall::FanOutBackend localUut{
+    std::make_shared<::yall::SequencePrefixingBackend>(decoratedMock1, "prefix"),
+    reader,
+    std::make_shared<::yall::NullBackend>()
+  };
+
+  ::yall::LoggerMessage prefixed;
+  EXPECT_CALL(*decoratedMock1, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&prefixed));
+
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"test", "test value"});
+  localUut.take(std::move(msg));
+
+  EXPECT_EQ(2, prefixed.sequence.size());
+  EXPECT_EQ(1, reader->size);
+  EXPECT_EQ(0, reader->copies);
+}
+
+TEST_F(YallFanOutBackendShould, HandStorageBackWhenNobodyKeptTheMessage) {
+  ::yall::FanOutBackend localUut{std::make_shared<::yall::NullBackend>(), std::make_shared<::yall::NullBackend>()};
+
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"test", "test value"});
+  localUut.take(std::move(msg));
+
+  EXPECT_EQ(1, msg.sequence.size());
+}
+
+struct BlockingBackend: public ::yall::LoggerBackend {
+  void take(::yall::LoggerMessage&&) override {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this]() { return open; });
+  }
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    open = true;
+    released.notify_all();
+  }
+  std::mutex mutex;
+  std::condition_variable released;
+  bool open = false;
+};
+
+TEST_F(YallFanOutBackendShould, NotLetSlowChildDelayOthersInParallel) {
+  auto slow = std::make_shared<BlockingBackend>();
+  auto fast = std::make_shared<SharedReadingBackend>();
+  ::yall::FanOutBackend localUut({slow, fast}, ::yall::Dispatch::Parallel);
+
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"test", "test value"});
+  localUut.take(std::move(msg));
+
+  for (int i = 0; i < 1000 && fast->size == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(1, fast->size);
+
+  slow->release();
+  localUut.flush();
+}
+
 struct YallSequencePrefixingBackendShould: public ::testing::Test {
   YallSequencePrefixingBackendShould():
   decoratedMock(std::make_shared<MockLoggerBackend>()),
@@ -140,4 +292,303 @@ TEST_F(YallSequencePrefixingBackendShould, PrefixSequenceAndForward) {
   EXPECT_EQ("test prefix", msg.sequence[0].value);
 }
 
+
+struct RecordingBackend: public ::yall::LoggerBackend {
+  void take(::yall::LoggerMessage&& msg) override {
+    std::this_thread::sleep_for(delay);
+    std::lock_guard<std::mutex> lock(mutex);
+    received.push_back(std::move(msg));
+  }
+  void takeBatch(::yall::LoggerMessage* first, ::yall::LoggerMessage* last) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++batches;
+    }
+    LoggerBackend::takeBatch(first, last);
+  }
+  std::vector<::yall::LoggerMessage> snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return received;
+  }
+  std::chrono::microseconds delay{0};
+  std::mutex mutex;
+  std::vector<::yall::LoggerMessage> received;
+  size_t batches = 0;
+};
+
+::yall::LoggerMessage numbered(int i) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"test", std::to_string(i)});
+  return msg;
+}
+
+struct YallAsyncBackendShould: public ::testing::Test {
+  YallAsyncBackendShould():
+    recorder(std::make_shared<RecordingBackend>()) {
+  }
+  std::shared_ptr<RecordingBackend> recorder;
+};
+
+TEST_F(YallAsyncBackendShould, ForwardInOrderAfterFlush) {
+  ::yall::AsyncBackend uut(recorder, 16);
+  for (int i = 0; i < 100; ++i) {
+    uut.take(numbered(i));
+  }
+  uut.flush();
+
+  auto received = recorder->snapshot();
+  ASSERT_EQ(100, received.size());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(std::to_string(i), received[i].sequence[0].value);
+  }
+}
+
+TEST_F(YallAsyncBackendShould, DrainQueueOnDestruction) {
+  recorder->delay = std::chrono::microseconds(100);
+  {
+    ::yall::AsyncBackend uut(recorder);
+    for (int i = 0; i < 50; ++i) {
+      uut.take(numbered(i));
+    }
+  }
+  EXPECT_EQ(50, recorder->snapshot().size());
+}
+
+TEST_F(YallAsyncBackendShould, AcceptFromManyThreads) {
+  {
+    ::yall::AsyncBackend uut(recorder, 8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&uut]() {
+        for (int i = 0; i < 1000; ++i) uut.take(numbered(i));
+      });
+    }
+    for (auto& t : threads) t.join();
+  }
+  EXPECT_EQ(4000, recorder->snapshot().size());
+}
+
+TEST_F(YallAsyncBackendShould, BeBuildableAsDecorator) {
+  auto stream = std::make_shared<std::stringstream>();
+  auto backend = ::yall::BackendBuilder()
+    .makeStream(stream)
+    .decorate<::yall::AsyncBackend>()
+    .take();
+  backend->take(numbered(7));
+  std::static_pointer_cast<::yall::AsyncBackend>(backend)->flush();
+  EXPECT_EQ("7\n", stream->str());
+}
+
+TEST_F(YallAsyncBackendShould, HandOverQueuedMessagesInBatches) {
+  recorder->delay = std::chrono::microseconds(200);
+  {
+    ::yall::AsyncBackend uut(recorder, 64);
+    for (int i = 0; i < 50; ++i) {
+      uut.take(numbered(i));
+    }
+  }
+
+  auto received = recorder->snapshot();
+  ASSERT_EQ(50, received.size());
+  EXPECT_LT(recorder->batches, 50);
+}
+
+// Holds the worker in its first batch until opened.
+struct GatedRecorder: public RecordingBackend {
+  void takeBatch(::yall::LoggerMessage* first, ::yall::LoggerMessage* last) override {
+    {
+      std::unique_lock<std::mutex> lock(gateMutex);
+      entered = true;
+      changed.notify_all();
+      changed.wait(lock, [this]() { return open; });
+    }
+    RecordingBackend::takeBatch(first, last);
+  }
+  void waitUntilEntered() {
+    std::unique_lock<std::mutex> lock(gateMutex);
+    changed.wait(lock, [this]() { return entered; });
+  }
+  void release() {
+    std::lock_guard<std::mutex> lock(gateMutex);
+    open = true;
+    changed.notify_all();
+  }
+  std::mutex gateMutex;
+  std::condition_variable changed;
+  bool entered = false;
+  bool open = false;
+};
+
+::yall::LoggerMessage numbered(int i, ::yall::Priority p) {
+  auto msg = numbered(i);
+  msg.meta.setPriority(p);
+  return msg;
+}
+
+struct YallAsyncOverflowShould: public ::testing::Test {
+  YallAsyncOverflowShould():
+    recorder(std::make_shared<GatedRecorder>()) {
+  }
+
+  // Message 0 is held by the worker, 1 and 2 fill the queue of two.
+  void fill(::yall::AsyncBackend& uut, ::yall::Priority p = ::yall::Priority::Info) {
+    uut.take(numbered(0, p));
+    recorder->waitUntilEntered();
+    uut.take(numbered(1, p));
+    uut.take(numbered(2, p));
+  }
+
+  std::vector<std::string> values() {
+    std::vector<std::string> ret;
+    for (auto& msg : recorder->snapshot()) {
+      ret.push_back(msg.sequence[0].value);
+    }
+    return ret;
+  }
+
+  std::shared_ptr<GatedRecorder> recorder;
+};
+
+TEST_F(YallAsyncOverflowShould, DropNewest) {
+  ::yall::OverflowPolicy policy = ::yall::OverflowPolicy::dropNewest();
+  policy.reportInterval = std::chrono::milliseconds(0);
+  ::yall::AsyncBackend uut(recorder, 2, policy);
+  fill(uut);
+  uut.take(numbered(3));
+  uut.take(numbered(4));
+  EXPECT_EQ(2u, uut.dropped());
+  EXPECT_EQ(2u, uut.dropped(::yall::Priority::Debug));
+
+  recorder->release();
+  uut.flush();
+  EXPECT_EQ((std::vector<std::string>{"0", "1", "2"}), values());
+}
+
+TEST_F(YallAsyncOverflowShould, DropOldest) {
+  ::yall::OverflowPolicy policy = ::yall::OverflowPolicy::dropOldest();
+  policy.reportInterval = std::chrono::milliseconds(0);
+  ::yall::AsyncBackend uut(recorder, 2, policy);
+  fill(uut);
+  uut.take(numbered(3));
+  uut.take(numbered(4));
+  EXPECT_EQ(2u, uut.dropped());
+  EXPECT_EQ(2u, uut.dropped(::yall::Priority::Info));
+
+  recorder->release();
+  uut.flush();
+  EXPECT_EQ((std::vector<std::string>{"0", "3", "4"}), values());
+}
+
+TEST_F(YallAsyncOverflowShould, GiveUpBlockingAfterTimeout) {
+  ::yall::OverflowPolicy policy = ::yall::OverflowPolicy::block(std::chrono::milliseconds(1));
+  policy.reportInterval = std::chrono::milliseconds(0);
+  ::yall::AsyncBackend uut(recorder, 2, policy);
+  fill(uut);
+  uut.take(numbered(3));
+  EXPECT_EQ(1u, uut.dropped());
+  recorder->release();
+}
+
+TEST_F(YallAsyncOverflowShould, DropBelowPriorityButKeepErrors) {
+  ::yall::OverflowPolicy policy = ::yall::OverflowPolicy::dropBelow(::yall::Priority::Error);
+  policy.reportInterval = std::chrono::milliseconds(0);
+  ::yall::AsyncBackend uut(recorder, 2, policy);
+  fill(uut, ::yall::Priority::Warning);
+  uut.take(numbered(3, ::yall::Priority::Warning));
+  EXPECT_EQ(1u, uut.dropped(::yall::Priority::Warning));
+
+  std::thread error([&uut]() { uut.take(numbered(4, ::yall::Priority::Error)); });
+  recorder->release();
+  error.join();
+  uut.flush();
+  EXPECT_EQ((std::vector<std::string>{"0", "1", "2", "4"}), values());
+  EXPECT_EQ(1u, uut.dropped());
+}
+
+TEST_F(YallAsyncOverflowShould, DropMessagesWithoutPriorityAsDebug) {
+  ::yall::OverflowPolicy policy = ::yall::OverflowPolicy::dropBelow(::yall::Priority::Warning);
+  policy.reportInterval = std::chrono::milliseconds(0);
+  ::yall::AsyncBackend uut(recorder, 2, policy);
+  fill(uut, ::yall::Priority::Warning);
+  // Left over from an earlier message, as in a recycled one.
+  auto msg = numbered(3);
+  msg.meta.priority = ::yall::Priority::Error;
+  uut.take(std::move(msg));
+  EXPECT_EQ(1u, uut.dropped(::yall::Priority::Debug));
+  EXPECT_EQ(0u, uut.dropped(::yall::Priority::Error));
+  recorder->release();
+}
+
+TEST_F(YallAsyncOverflowShould, ReportDropsAsARecord) {
+  {
+    ::yall::AsyncBackend uut(recorder, 2, ::yall::OverflowPolicy::dropNewest());
+    fill(uut);
+    uut.take(numbered(3, ::yall::Priority::Debug));
+    uut.take(numbered(4, ::yall::Priority::Info));
+    uut.take(numbered(5, ::yall::Priority::Info));
+    recorder->release();
+  }
+  auto received = recorder->snapshot();
+  ASSERT_EQ(4u, received.size());
+  EXPECT_EQ(::yall::Priority::Warning, received.back().meta.priority);
+  EXPECT_EQ("yall: dropped 3 messages on a full queue (debug 1, info 2, warning 0, error 0)",
+            received.back().sequence[0].value);
+}
+
+TEST_F(YallAsyncOverflowShould, NotReportDropsWhenReportingIsOff) {
+  {
+    ::yall::OverflowPolicy policy = ::yall::OverflowPolicy::dropNewest();
+    policy.reportInterval = std::chrono::milliseconds(0);
+    ::yall::AsyncBackend uut(recorder, 2, policy);
+    fill(uut);
+    uut.take(numbered(3));
+    EXPECT_EQ(1u, uut.dropped());
+    recorder->release();
+  }
+  EXPECT_EQ((std::vector<std::string>{"0", "1", "2"}), values());
+}
+
+struct YallBatchingShould: public ::testing::Test {
+  YallBatchingShould():
+    recorder(std::make_shared<RecordingBackend>()) {
+    batch.push_back(numbered(1));
+    batch.push_back(numbered(2));
+  }
+  void takeBatch(::yall::LoggerBackend& uut) {
+    uut.takeBatch(batch.data(), batch.data() + batch.size());
+  }
+  std::shared_ptr<RecordingBackend> recorder;
+  std::vector<::yall::LoggerMessage> batch;
+};
+
+TEST_F(YallBatchingShould, HandBatchToTakeByDefault) {
+  auto mock = std::make_shared<MockLoggerBackend>();
+  EXPECT_CALL(*mock, take(::testing::_)).Times(2);
+  takeBatch(*mock);
+}
+
+TEST_F(YallBatchingShould, PassWholeBatchThroughDecorators) {
+  auto chain = std::make_shared<::yall::PrefixDecoratingBackend>(
+    std::make_shared<::yall::PriorityDecoratingBackend>(
+      std::make_shared<::yall::FmtEvaluatingBackend>(
+        std::make_shared<::yall::MetaFormattingBackend>(recorder, "%p %n %m")),
+      ::yall::Priority::Error),
+    "app");
+  takeBatch(*chain);
+
+  EXPECT_EQ(1, recorder->batches);
+  auto received = recorder->snapshot();
+  ASSERT_EQ(2, received.size());
+  EXPECT_EQ("error app 1", received[0].sequence[0].value);
+  EXPECT_EQ("error app 2", received[1].sequence[0].value);
+}
+
+TEST_F(YallBatchingShould, WriteBatchToStream) {
+  auto stream = std::make_shared<std::stringstream>();
+  ::yall::StreamBackend uut(stream);
+  takeBatch(uut);
+
+  EXPECT_EQ("1\n2\n", stream->str());
+}
+
 }
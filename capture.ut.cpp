@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "yall/capture.hpp"
+#include "yall/fmt.hpp"
+
+#include <sstream>
+
+namespace {
+
+struct YallCaptureShould: public ::testing::Test {
+  template <typename T>
+  ::yall::TypeAndValue captured(const T& t) {
+    ::yall::TypeAndValue tv;
+    capture(tv, t);
+    return tv;
+  }
+  using Kind = ::yall::CapturedValue::Kind;
+};
+
+TEST_F(YallCaptureShould, KeepNumbersNative) {
+  auto tv = captured(-42);
+  EXPECT_EQ(Kind::Signed, tv.captured.kind);
+  EXPECT_EQ(-42, tv.captured.i);
+  EXPECT_TRUE(tv.value.empty());
+
+  EXPECT_EQ(Kind::Unsigned, captured(42u).captured.kind);
+  EXPECT_EQ(Kind::Floating, captured(1.5).captured.kind);
+  EXPECT_EQ(Kind::Character, captured('c').captured.kind);
+}
+
+TEST_F(YallCaptureShould, CopyStringBytes) {
+  std::string str = "test";
+  auto tv = captured(str);
+  str = "changed";
+  EXPECT_EQ(Kind::None, tv.captured.kind);
+  EXPECT_EQ("test", tv.value);
+}
+
+TEST_F(YallCaptureShould, KeepPointerToFormatString) {
+  static const char fmt[] = "${1}";
+  auto tv = captured(::yall::detail::Fmt<1>(fmt));
+  EXPECT_EQ(Kind::StaticString, tv.captured.kind);
+  EXPECT_EQ(fmt, tv.captured.s);
+}
+
+struct YallCaptureWithSpecShould: public YallCaptureShould {
+  template <typename T>
+  std::string render(const T& t, const char* spec) {
+    std::string ret;
+    appendText(ret, captured(t), ::yall::detail::readSpec(spec, spec + strlen(spec)));
+    return ret;
+  }
+};
+
+TEST_F(YallCaptureWithSpecShould, PadAndAlign) {
+  EXPECT_EQ("abc  ", render("abc", "5"));
+  EXPECT_EQ("   42", render(42, "5"));
+  EXPECT_EQ("**abc**", render("abc", "*^7"));
+  EXPECT_EQ("42---", render(42, "-<5"));
+  EXPECT_EQ("toolong", render("toolong", "3"));
+}
+
+TEST_F(YallCaptureWithSpecShould, PutZeroPaddingAfterSign) {
+  EXPECT_EQ("-00042", render(-42, "06"));
+  EXPECT_EQ("+00042", render(42, "+06"));
+  EXPECT_EQ(" 42", render(42, " "));
+  EXPECT_EQ("-0003.50", render(-3.5, "08.2f"));
+}
+
+TEST_F(YallCaptureWithSpecShould, UseRadix) {
+  EXPECT_EQ("ff", render(255, "x"));
+  EXPECT_EQ("FF", render(255u, "X"));
+  EXPECT_EQ("377", render(255, "o"));
+  EXPECT_EQ("00001010", render(10, "08b"));
+  EXPECT_EQ("-ff", render(-255, "x"));
+  EXPECT_EQ("99", render('c', "d"));
+  EXPECT_EQ("18446744073709551615", render(18446744073709551615ull, "d"));
+  EXPECT_EQ("-9223372036854775808", render(-9223372036854775807ll - 1, "d"));
+}
+
+TEST_F(YallCaptureWithSpecShould, SeparateThousands) {
+  EXPECT_EQ("1,234,567", render(1234567, ","));
+  EXPECT_EQ("-1,234", render(-1234, ",d"));
+  EXPECT_EQ("123", render(123, ","));
+  EXPECT_EQ("1,234,567.89", render(1234567.891, ",.2f"));
+}
+
+TEST_F(YallCaptureWithSpecShould, UsePrecision) {
+  EXPECT_EQ("3.14", render(3.14159, ".2f"));
+  EXPECT_EQ("3.142e+00", render(3.14159, ".3e"));
+  EXPECT_EQ("0.5", render(0.5, "g"));
+  EXPECT_EQ("2.00", render(2, ".2f"));
+  EXPECT_EQ("ab", render("abc", ".2"));
+}
+
+TEST_F(YallCaptureShould, RenderLikeEagerConversion) {
+  EXPECT_EQ(::yall::toString(-42), text(captured(-42)));
+  EXPECT_EQ(::yall::toString(42ull), text(captured(42ull)));
+  EXPECT_EQ(::yall::toString(1.5), text(captured(1.5)));
+  EXPECT_EQ("c", text(captured('c')));
+  EXPECT_EQ("str", text(captured("str")));
+}
+
+TEST_F(YallCaptureShould, WriteTextToStream) {
+  std::stringstream ss;
+  writeText(ss, captured(7)) << ' ';
+  writeText(ss, captured('x'));
+  EXPECT_EQ("7 x", ss.str());
+}
+
+TEST_F(YallCaptureShould, MaterializeMessageInPlace) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.push_back(captured(7));
+  msg.sequence.push_back(captured("text"));
+
+  materialize(msg);
+
+  EXPECT_EQ(Kind::None, msg.sequence[0].captured.kind);
+  EXPECT_EQ("7", msg.sequence[0].value);
+  EXPECT_EQ("text", msg.sequence[1].value);
+}
+
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include "yall/dedup.hpp"
+#include "yall/fmt.hpp"
+#include "yall/logger.hpp"
+#include "yall/mocks.hpp"
+#include "yall/prefix.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct YallDedupBackendShould: public ::testing::Test {
+  YallDedupBackendShould():
+    decoratedMock(std::make_shared<MockLoggerBackend>()),
+    uut(std::make_shared<::yall::DedupBackend>(decoratedMock, std::chrono::milliseconds(100))) {
+    EXPECT_CALL(*decoratedMock, take(::testing::_))
+      .WillRepeatedly(::testing::Invoke([this](::yall::LoggerMessage& msg) {
+        std::string text;
+        for (const auto& tv : msg.sequence)
+          text += tv.value;
+        forwarded.push_back(text);
+      }));
+  }
+
+  ::yall::LoggerMessage message(const std::string& text, int ms) {
+    ::yall::LoggerMessage msg;
+    msg.meta.timeStamp = start + std::chrono::milliseconds(ms);
+    msg.sequence.push_back(::yall::TypeAndValue{"text", text});
+    return msg;
+  }
+
+  std::shared_ptr<MockLoggerBackend> decoratedMock;
+  std::shared_ptr<::yall::DedupBackend> uut;
+  std::vector<std::string> forwarded;
+  ::yall::TimeStamp start = std::chrono::system_clock::now();
+};
+
+TEST_F(YallDedupBackendShould, ReportRepeatsWhenTheWindowIsOver) {
+  uut->take(message("same", 0));
+  uut->take(message("same", 10));
+  uut->take(message("other", 20));
+  uut->take(message("same", 40));
+  EXPECT_EQ((std::vector<std::string>{"same", "other"}), forwarded);
+
+  uut->take(message("same", 150));
+  EXPECT_EQ((std::vector<std::string>{"same", "other", "repeated 2 times over 40 ms: same", "same"}), forwarded);
+}
+
+TEST_F(YallDedupBackendShould, ReportRepeatsOnFlush) {
+  uut->take(message("same", 0));
+  uut->take(message("same", 5));
+  uut->flush();
+  uut->take(message("same", 6));
+
+  EXPECT_EQ((std::vector<std::string>{"same", "repeated 1 times over 5 ms: same", "same"}), forwarded);
+}
+
+TEST_F(YallDedupBackendShould, ReportExpiredRepeatsWithoutALaterMessage) {
+  uut->take(message("same", 0));
+  uut->take(message("same", 10));
+  uut->reportExpired(start + std::chrono::milliseconds(50));
+  EXPECT_EQ((std::vector<std::string>{"same"}), forwarded);
+
+  uut->reportExpired(start + std::chrono::milliseconds(100));
+  EXPECT_EQ((std::vector<std::string>{"same", "repeated 1 times over 10 ms: same"}), forwarded);
+}
+
+TEST_F(YallDedupBackendShould, TellMessagesApartByPrefixAndPriority) {
+  auto msg = message("same", 0);
+  uut->take(::yall::LoggerMessage(msg));
+  msg.meta.prefix = ::yall::internPrefix("dedup");
+  uut->take(::yall::LoggerMessage(msg));
+  msg.meta.setPriority(::yall::Priority::Error);
+  uut->take(::yall::LoggerMessage(msg));
+  msg.meta.threadId = ::yall::ThreadId();
+  msg.meta.timeStamp += std::chrono::milliseconds(1);
+  uut->take(::yall::LoggerMessage(msg));
+
+  EXPECT_EQ(3, forwarded.size());
+}
+
+TEST_F(YallDedupBackendShould, CollapseDeferredMessagesByArguments) {
+  ::yall::Logger log(uut, ::yall::Capture::Deferred);
+  for (int i = 0; i < 3; ++i) {
+    log.log(MakeFmt("value ${1}"), 42);
+    log.log(MakeFmt("value ${1}"), i);
+  }
+  uut->flush();
+
+  EXPECT_EQ(5, forwarded.size());
+  EXPECT_EQ("repeated 2 times over ", forwarded.back().substr(0, 22));
+}
+
+TEST_F(YallDedupBackendShould, ReportFmtMessagesFormatted) {
+  for (auto mode : {::yall::Capture::Eager, ::yall::Capture::Deferred}) {
+    forwarded.clear();
+    auto dedup = std::make_shared<::yall::DedupBackend>(std::make_shared<::yall::FmtEvaluatingBackend>(decoratedMock));
+    ::yall::Logger log(dedup, mode);
+    for (int i = 0; i < 3; ++i)
+      log.log(MakeFmt("value ${1}"), 42);
+    dedup->flush();
+
+    ASSERT_EQ(2, forwarded.size());
+    EXPECT_EQ("value 42", forwarded[0]);
+    EXPECT_EQ("repeated 2 times over ", forwarded[1].substr(0, 22));
+    EXPECT_EQ(" ms: value 42", forwarded[1].substr(forwarded[1].size() - 13));
+  }
+}
+
+TEST_F(YallDedupBackendShould, KeepAlternatingMessagesOfOneSet) {
+  ::yall::DedupBackend oneSet(decoratedMock, std::chrono::milliseconds(100), ::yall::DedupBackend::ways);
+  for (const char* text : {"a", "b", "a", "b", "c", "a", "d", "b"})
+    oneSet.take(message(text, 0));
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "c", "d"}), forwarded);
+
+  oneSet.flush();
+  ASSERT_EQ(6, forwarded.size());
+  EXPECT_EQ(2, std::count(forwarded.begin(), forwarded.end(), "repeated 2 times over 0 ms: a")
+    + std::count(forwarded.begin(), forwarded.end(), "repeated 2 times over 0 ms: b"));
+}
+
+TEST_F(YallDedupBackendShould, KeepPassingPartOfBatchInOrder) {
+  std::vector<::yall::LoggerMessage> batch;
+  batch.push_back(message("a", 0));
+  batch.push_back(message("a", 1));
+  batch.push_back(message("b", 2));
+  batch.push_back(message("b", 3));
+  batch.push_back(message("a", 200));
+  uut->takeBatch(batch.data(), batch.data() + batch.size());
+
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "repeated 1 times over 1 ms: a", "repeated 1 times over 1 ms: b", "a"}),
+            forwarded);
+}
+
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include "yall/file.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+
+::yall::LoggerMessage line(const std::string& text) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(::yall::TypeAndValue{"test", text});
+  return msg;
+}
+
+struct YallFileBackendShould : public ::testing::Test {
+  void SetUp() override {
+    char dirTemplate[] = "/tmp/yall_file_XXXXXX";
+    dir = mkdtemp(dirTemplate);
+    path = dir + "/test.log";
+  }
+
+  void TearDown() override {
+    std::remove(path.c_str());
+    for (int i = 1; i <= 3; ++i) {
+      std::remove((path + '.' + std::to_string(i)).c_str());
+    }
+    ::rmdir(dir.c_str());
+  }
+
+  std::string read(const std::string& file) {
+    std::ifstream in(file);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+  }
+
+  // Static policy, nothing is written unless asked for.
+  ::yall::FilePolicy quiet() {
+    ::yall::FilePolicy policy;
+    policy.flushBytes = 0;
+    policy.flushInterval = std::chrono::milliseconds(0);
+    return policy;
+  }
+
+  std::string dir;
+  std::string path;
+};
+
+TEST_F(YallFileBackendShould, KeepMessagesBufferedUntilFlush) {
+  ::yall::FileBackend uut(path, quiet());
+  uut.take(line("first"));
+  uut.take(line("second"));
+
+  EXPECT_EQ("", read(path));
+
+  uut.flush();
+  EXPECT_EQ("first\nsecond\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, RenderDeferredCaptures) {
+  ::yall::FileBackend uut(path, quiet());
+  auto msg = line("number ");
+  msg.sequence.emplace_back();
+  msg.sequence.back().captured.kind = ::yall::CapturedValue::Kind::Signed;
+  msg.sequence.back().captured.i = -42;
+  uut.take(std::move(msg));
+
+  uut.flush();
+  EXPECT_EQ("number -42\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, WriteUrgentMessagesImmediately) {
+  ::yall::FileBackend uut(path, quiet());
+  uut.take(line("before"));
+  auto msg = line("error");
+  msg.meta.setPriority(::yall::Priority::Error);
+  uut.take(std::move(msg));
+
+  EXPECT_EQ("before\nerror\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, WriteOnShutdown) {
+  {
+    ::yall::FileBackend uut(path, quiet());
+    uut.take(line("last words"));
+  }
+  EXPECT_EQ("last words\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, WriteInBackgroundPastByteThreshold) {
+  auto policy = quiet();
+  policy.flushBytes = 8;
+  ::yall::FileBackend uut(path, policy);
+  uut.take(line("short"));
+  uut.take(line("over the threshold"));
+
+  for (int i = 0; i < 1000 && read(path).empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ("short\nover the threshold\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, WriteInBackgroundPeriodically) {
+  auto policy = quiet();
+  policy.flushInterval = std::chrono::milliseconds(5);
+  ::yall::FileBackend uut(path, policy);
+  uut.take(line("tick"));
+
+  for (int i = 0; i < 1000 && read(path).empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ("tick\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, AppendToExistingFile) {
+  {
+    std::ofstream out(path);
+    out << "old\n";
+  }
+  ::yall::FileBackend uut(path, quiet());
+  uut.take(line("new"));
+  uut.flush();
+
+  EXPECT_EQ("old\nnew\n", read(path));
+}
+
+TEST_F(YallFileBackendShould, RotateBySizeKeepingNewestFirst) {
+  auto policy = quiet();
+  policy.rotateBytes = 4;
+  policy.keepFiles = 2;
+  ::yall::FileBackend uut(path, policy);
+
+  for (auto text : {"one", "two", "three", "four"}) {
+    uut.take(line(text));
+    uut.flush();
+  }
+
+  EXPECT_EQ("", read(path));
+  EXPECT_EQ("four\n", read(path + ".1"));
+  EXPECT_EQ("three\n", read(path + ".2"));
+  EXPECT_EQ("", read(path + ".3"));
+}
+
+TEST_F(YallFileBackendShould, DropAndCountWhenAllBuffersWait) {
+  auto policy = quiet();
+  policy.maxBuffers = 1;
+  ::yall::FileBackend uut(path, policy);
+  const std::string full(::yall::FileBackend::bufferSize, 'x');
+  uut.take(line(full));
+  uut.take(line("dropped"));
+  uut.take(line("dropped"));
+  EXPECT_EQ(2, uut.dropped());
+
+  uut.flush();
+  uut.take(line("kept"));
+  uut.flush();
+  EXPECT_EQ(full + "\nkept\n", read(path));
+  EXPECT_EQ(2, uut.dropped());
+}
+
+TEST_F(YallFileBackendShould, CountFailedWrites) {
+  ::yall::FileBackend uut("/dev/full", quiet());
+  uut.take(line("lost"));
+  uut.flush();
+  EXPECT_EQ(1, uut.writeErrors());
+}
+
+TEST_F(YallFileBackendShould, ReportFileThatCannotBeOpened) {
+  EXPECT_THROW(::yall::FileBackend(dir + "/missing/test.log"), std::system_error);
+}
+
+}
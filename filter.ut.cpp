@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include "yall/backends.hpp"
+#include "yall/filter.hpp"
+#include "yall/mocks.hpp"
+#include "yall/prefix.hpp"
+
+#include <vector>
+
+namespace {
+
+::yall::LoggerMessage message(const std::string& prefix, ::yall::Priority p) {
+  ::yall::LoggerMessage msg;
+  msg.meta.prefix = ::yall::internPrefix(prefix);
+  msg.meta.priority = p;
+  msg.meta.hasPriority = true;
+  return msg;
+}
+
+TEST(YallFilterRulesShould, ApplyTheMostSpecificRule) {
+  ::yall::FilterRules uut("db.* >= warning, net.http.* >= debug, net.http >= info, * >= info");
+
+  EXPECT_FALSE(uut.passes(message("db", ::yall::Priority::Info)));
+  EXPECT_TRUE(uut.passes(message("db.pool", ::yall::Priority::Warning)));
+  EXPECT_FALSE(uut.passes(message("db.pool.conn", ::yall::Priority::Info)));
+  EXPECT_TRUE(uut.passes(message("net.http.client", ::yall::Priority::Debug)));
+  EXPECT_FALSE(uut.passes(message("net.http", ::yall::Priority::Debug)));
+  EXPECT_TRUE(uut.passes(message("net.http", ::yall::Priority::Info)));
+  EXPECT_FALSE(uut.passes(message("net", ::yall::Priority::Debug)));
+  EXPECT_FALSE(uut.passes(message("dbx", ::yall::Priority::Debug)));
+  EXPECT_TRUE(uut.passes(::yall::internPrefix("dbx"), ::yall::Priority::Error));
+}
+
+TEST(YallFilterRulesShould, MatchExactNamesOnlyWithoutWildcard) {
+  ::yall::FilterRules uut("app.db >= error, app.* >= off");
+
+  EXPECT_TRUE(uut.passes(message("app.db", ::yall::Priority::Error)));
+  EXPECT_FALSE(uut.passes(message("app.db.pool", ::yall::Priority::Error)));
+  EXPECT_FALSE(uut.passes(message("app", ::yall::Priority::Error)));
+  EXPECT_TRUE(uut.passes(message("other", ::yall::Priority::Debug)));
+}
+
+TEST(YallFilterRulesShould, LetLaterWildcardsReplaceEarlierOnes) {
+  ::yall::FilterRules raised("a.b.* >= warning, a.b.* >= error");
+  EXPECT_FALSE(raised.passes(message("a.b", ::yall::Priority::Warning)));
+  EXPECT_FALSE(raised.passes(message("a.b.c", ::yall::Priority::Warning)));
+
+  ::yall::FilterRules lowered("a.b.* >= error, a.b.* >= debug");
+  EXPECT_TRUE(lowered.passes(message("a.b", ::yall::Priority::Info)));
+  EXPECT_TRUE(lowered.passes(message("a.b.c", ::yall::Priority::Info)));
+
+  ::yall::FilterRules exactFirst("a.b >= info, a.b.* >= error");
+  EXPECT_TRUE(exactFirst.passes(message("a.b", ::yall::Priority::Info)));
+  EXPECT_FALSE(exactFirst.passes(message("a.b.c", ::yall::Priority::Info)));
+}
+
+TEST(YallFilterRulesShould, ApplyTheCatchAllToMessagesWithoutPrefix) {
+  ::yall::LoggerMessage msg;
+  EXPECT_TRUE(::yall::FilterRules("").passes(msg));
+  EXPECT_FALSE(::yall::FilterRules("* >= info").passes(msg));
+  msg.meta.setPriority(::yall::Priority::Info);
+  EXPECT_TRUE(::yall::FilterRules("* >= info, a.* >= off").passes(msg));
+}
+
+TEST(YallFilterRulesShould, TakeMessagesWithoutPriorityAsDebug) {
+  ::yall::LoggerMessage msg;
+  msg.meta.priority = ::yall::Priority::Error;
+  EXPECT_FALSE(::yall::FilterRules("* >= warning").passes(msg));
+}
+
+TEST(YallFilterRulesShould, RejectInvalidRules) {
+  EXPECT_THROW(::yall::FilterRules("db.*"), std::invalid_argument);
+  EXPECT_THROW(::yall::FilterRules("db.* >= loud"), std::invalid_argument);
+  EXPECT_THROW(::yall::FilterRules("db..pool >= info"), std::invalid_argument);
+  EXPECT_THROW(::yall::FilterRules("*.db >= info"), std::invalid_argument);
+  EXPECT_THROW(::yall::FilterRules("d* >= info"), std::invalid_argument);
+  EXPECT_THROW(::yall::FilterRules(" >= info"), std::invalid_argument);
+}
+
+struct YallFilteringBackendShould: public ::testing::Test {
+  YallFilteringBackendShould():
+    decoratedMock(std::make_shared<MockLoggerBackend>()),
+    uut(decoratedMock, "db.* >= warning, * >= debug") {
+  }
+  std::shared_ptr<MockLoggerBackend> decoratedMock;
+  ::yall::FilteringBackend uut;
+};
+
+TEST_F(YallFilteringBackendShould, ForwardOnlyPassingMessages) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+
+  uut.take(message("db.pool", ::yall::Priority::Info));
+  uut.take(message("db.pool", ::yall::Priority::Error));
+
+  EXPECT_EQ(::yall::Priority::Error, msg.meta.priority);
+}
+
+TEST_F(YallFilteringBackendShould, ReplaceRulesAtRuntime) {
+  EXPECT_CALL(*decoratedMock, take(::testing::_)).Times(2);
+
+  uut.take(message("db", ::yall::Priority::Info));
+  uut.setRules("db.* >= info");
+  uut.take(message("db", ::yall::Priority::Info));
+  EXPECT_THROW(uut.setRules("db.* >= "), std::invalid_argument);
+  uut.take(message("db", ::yall::Priority::Info));
+}
+
+TEST_F(YallFilteringBackendShould, SwitchBackToRulesGivenBefore) {
+  EXPECT_CALL(*decoratedMock, take(::testing::_)).Times(2);
+
+  uut.setRules("db.* >= info");
+  uut.take(message("db", ::yall::Priority::Info));
+  uut.setRules("db.* >= error");
+  uut.take(message("db", ::yall::Priority::Info));
+  uut.setRules("db.* >= info");
+  uut.take(message("db", ::yall::Priority::Info));
+}
+
+TEST_F(YallFilteringBackendShould, NotTakeThePriorityOfARecycledMessage) {
+  EXPECT_CALL(*decoratedMock, take(::testing::_)).Times(0);
+  // More fields than fit inline, so the message goes back to the pool.
+  ::yall::Logger(std::make_shared<::yall::NullBackend>())
+    .log(::yall::Priority::Error, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+
+  ::yall::Logger(std::make_shared<::yall::FilteringBackend>(decoratedMock, "* >= warning")).log("x");
+}
+
+TEST_F(YallFilteringBackendShould, ForwardPassingPartOfBatch) {
+  std::vector<::yall::Priority> forwarded;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .WillRepeatedly(::testing::Invoke([&forwarded](::yall::LoggerMessage& msg) {
+      forwarded.push_back(msg.meta.priority);
+    }));
+
+  std::vector<::yall::LoggerMessage> batch;
+  batch.push_back(message("db", ::yall::Priority::Info));
+  batch.push_back(message("db", ::yall::Priority::Error));
+  batch.push_back(message("db", ::yall::Priority::Debug));
+  batch.push_back(message("db", ::yall::Priority::Warning));
+  uut.takeBatch(batch.data(), batch.data() + batch.size());
+
+  EXPECT_EQ((std::vector<::yall::Priority>{::yall::Priority::Error, ::yall::Priority::Warning}), forwarded);
+}
+
+}
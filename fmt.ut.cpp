@@ -3,6 +3,7 @@
 
 #include "yall/mocks.hpp"
 #include "yall/fmt.hpp"
+#include "yall/logger.hpp"
 
 namespace {
 
@@ -42,8 +43,28 @@ TEST_F(YallDetailFmtFormatShould, ThrowIfPlaceholderIsNotNumeral) {
   throwsFor("${x}");
 }
 
-TEST_F(YallDetailFmtFormatShould, ReturnOneForSimpleTokenWithHint) {
-  inHasOut("${1:hint}", 1);
+TEST_F(YallDetailFmtFormatShould, ReturnOneForSimpleTokenWithSpec) {
+  inHasOut("${1:>8}", 1);
+  inHasOut("${1:}", 1);
+}
+
+TEST_F(YallDetailFmtFormatShould, ThrowForInvalidSpec) {
+  throwsFor("${1:hint}");
+  throwsFor("${1:8.}");
+  throwsFor("${1:,x}");
+  throwsFor("${1:.2d}");
+  throwsFor("${1:1000}");
+  throwsFor("${1:.100f}");
+}
+
+TEST_F(YallDetailFmtFormatShould, ReadSpecAtCompileTime) {
+  constexpr auto full = ::yall::detail::readPlaceholderWithSpec("{1:*^+012,.3f}").spec;
+  static_assert(full.fill == '*' && full.align == '^' && full.sign == '+', "fill, align and sign");
+  static_assert(full.zero && full.width == 12 && full.thousands, "zero, width and separator");
+  static_assert(full.hasPrecision && full.precision == 3 && full.type == 'f', "precision and type");
+
+  constexpr auto alignOnly = ::yall::detail::readPlaceholderWithSpec("{1:<}").spec;
+  static_assert(alignOnly.fill == '\0' && alignOnly.align == '<', "align without fill");
 }
 
 TEST_F(YallDetailFmtFormatShould, ReturnMaximalToken) {
@@ -58,6 +79,19 @@ TEST_F(YallDetailFmtFormatShould, BeAConstExpression) {
                 "placeholderCount is not constexpr or does not work");
 }
 
+TEST_F(YallDetailFmtFormatShould, SplitIntoSegmentsAtCompileTime) {
+  constexpr auto table = ::yall::detail::parseFmt<3>("ab${2}c${1:x}");
+  static_assert(table.literalLength == 3, "literal length is not computed at compile time");
+  static_assert(table.segments[0].offset == 0 && table.segments[0].length == 2, "first literal");
+  static_assert(table.segments[0].index == 2, "first placeholder");
+  static_assert(table.segments[1].offset == 6 && table.segments[1].length == 1, "second literal");
+  static_assert(table.segments[1].index == 1, "second placeholder");
+  static_assert(table.segments[2].length == 0 && table.segments[2].index == 0, "no trailing literal");
+}
+
+TEST_F(YallDetailFmtFormatShould, ThrowForPlaceholderZero) {
+  EXPECT_THROW(::yall::detail::parseFmt<2>("${0}"), std::logic_error);
+}
 
 struct YallFmtEvaluatingBackendShould: public ::testing::Test {
   YallFmtEvaluatingBackendShould():
@@ -87,5 +121,92 @@ TEST_F(YallFmtEvaluatingBackendShould, EvaluateFormatting) {
   uut.take(::yall::LoggerMessage(msg));
 }
 
+TEST_F(YallFmtEvaluatingBackendShould, EvaluateDeferredCaptures) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"yall::Fmt", ""});
+  capture(msg.sequence.back(), MakeFmt("${2}-${1}"));
+  msg.sequence.emplace_back(yall::TypeAndValue{"int", ""});
+  capture(msg.sequence.back(), 1);
+  msg.sequence.emplace_back(yall::TypeAndValue{"char", ""});
+  capture(msg.sequence.back(), 'c');
+
+  ::yall::LoggerMessage formatted;
+  formatted.sequence.emplace_back(yall::TypeAndValue{"yall::Formatted", "c-1"});
+
+  EXPECT_CALL(*decoratedMock, take(formatted)).Times(1);
+  uut.take(::yall::LoggerMessage(msg));
+}
+
+TEST_F(YallFmtEvaluatingBackendShould, EvaluateWithSegmentTable) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"yall::Fmt", ""});
+  capture(msg.sequence.back(), MakeFmt("<${2}|${1}|${2}>"));
+  ASSERT_EQ(::yall::CapturedValue::Kind::Format, msg.sequence.back().captured.kind);
+  msg.sequence.emplace_back(yall::TypeAndValue{"test", "one"});
+  msg.sequence.emplace_back(yall::TypeAndValue{"int", ""});
+  capture(msg.sequence.back(), 2);
+
+  ::yall::LoggerMessage formatted;
+  formatted.sequence.emplace_back(yall::TypeAndValue{"yall::Formatted", "<2|one|2>"});
+
+  EXPECT_CALL(*decoratedMock, take(formatted)).Times(1);
+  uut.take(::yall::LoggerMessage(msg));
+}
+
+TEST_F(YallFmtEvaluatingBackendShould, ApplySpecsToDeferredCaptures) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"yall::Fmt", ""});
+  capture(msg.sequence.back(), MakeFmt("[${1:>5}] ${2:#>4x} ${3:.2f} ${1:<4}|"));
+  msg.sequence.emplace_back(yall::TypeAndValue{"test", "ab"});
+  msg.sequence.emplace_back(yall::TypeAndValue{"int", ""});
+  capture(msg.sequence.back(), 255);
+  msg.sequence.emplace_back(yall::TypeAndValue{"double", ""});
+  capture(msg.sequence.back(), 3.14159);
+
+  ::yall::LoggerMessage formatted;
+  formatted.sequence.emplace_back(yall::TypeAndValue{"yall::Formatted", "[   ab] ##ff 3.14 ab  |"});
+
+  EXPECT_CALL(*decoratedMock, take(formatted)).Times(1);
+  uut.take(::yall::LoggerMessage(msg));
+}
+
+TEST_F(YallFmtEvaluatingBackendShould, ApplySpecsWhenParsingAtRuntime) {
+  ::yall::LoggerMessage msg;
+  msg.sequence.emplace_back(yall::TypeAndValue{"yall::Fmt", "${1:05}"});
+  msg.sequence.emplace_back(yall::TypeAndValue{"int", ""});
+  capture(msg.sequence.back(), -42);
+
+  ::yall::LoggerMessage formatted;
+  formatted.sequence.emplace_back(yall::TypeAndValue{"yall::Formatted", "-0042"});
+
+  EXPECT_CALL(*decoratedMock, take(formatted)).Times(1);
+  uut.take(::yall::LoggerMessage(msg));
+}
+
+TEST_F(YallFmtEvaluatingBackendShould, ApplySpecsToEagerArguments) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .Times(2).WillRepeatedly(::testing::SaveArg<0>(&msg));
+
+  for (auto mode : {::yall::Capture::Eager, ::yall::Capture::Deferred}) {
+    ::yall::Logger log(std::make_shared<::yall::FmtEvaluatingBackend>(decoratedMock), mode);
+    log.log(MakeFmt("[${1:.2f}] [${2:x}] [${3:08.3f}] [${4:05}] [${5:>3}]"), 3.14159, 255, 2.5, -42, 'c');
+    ASSERT_EQ(1, msg.sequence.size());
+    EXPECT_EQ("[3.14] [ff] [0002.500] [-0042] [  c]", msg.sequence[0].value);
+  }
+}
+
+TEST_F(YallFmtEvaluatingBackendShould, KeepEagerTextOfFmtArguments) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*decoratedMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+
+  ::yall::Logger log(decoratedMock);
+  log.log(MakeFmt("${1} ${2}"), 255, ::yall::lazy([]() { return 2.5; }));
+  ASSERT_EQ(3, msg.sequence.size());
+  EXPECT_EQ("255", msg.sequence[1].value);
+  EXPECT_EQ("2.5", msg.sequence[2].value);
+  EXPECT_EQ(::yall::CapturedValue::Kind::Floating, msg.sequence[2].captured.kind);
+}
 
 }
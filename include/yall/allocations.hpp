@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counting for tests and benchmarks.
+// Define YALL_COUNT_ALLOCATIONS before including this header in exactly one
+// translation unit of the executable to replace the global operator new.
+
+namespace yall {
+namespace testing {
+
+inline std::atomic<size_t>& allocationCount() {
+  static std::atomic<size_t> count(0);
+  return count;
+}
+
+class AllocationCounter {
+public:
+  AllocationCounter() : start(allocationCount().load()) {}
+
+  size_t count() const {
+    return allocationCount().load() - start;
+  }
+
+private:
+  size_t start;
+};
+
+} // namespace testing
+} // namespace yall
+
+#ifdef YALL_COUNT_ALLOCATIONS
+
+void* operator new(size_t size) {
+  ::yall::testing::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+#endif
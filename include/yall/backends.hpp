@@ -1,39 +1,82 @@
 #pragma once
 #include "yall/types.hpp"
+#include "yall/capture.hpp"
+#include "yall/priority.hpp"
+#include "yall/pool.hpp"
+#include "yall/toString.hpp"
+#include "yall/queue.hpp"
+#include "yall/layout.hpp"
+#include <atomic>
+#include <chrono>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 
 namespace yall {
 
+// Replaces the message with a single line laid out by a Layout pattern,
+// e.g. "%d %t <%i> %-8p -%n- %m". The pattern is compiled once, here.
 class MetaFormattingBackend: public LoggerBackend {
 public:
-  explicit MetaFormattingBackend(std::shared_ptr<LoggerBackend> toDecorate): decorated(toDecorate) {}
+  explicit MetaFormattingBackend(
+    std::shared_ptr<LoggerBackend> toDecorate,
+    TimeStampFormatter timeFormatter = TimeStampFormatter::local()
+  ): decorated(toDecorate), layout(Layout::defaultPattern(), timeFormatter) {}
 
-  void take(LoggerMessage&& msg) override {
-    std::stringstream ss;
-    ss << msg.meta["yall::TimeStamp"]
-      << " <" << msg.meta["yall::ThreadId"] << "> "
-      << std::setw(8) << msg.meta["yall::Priority"] << " -"
-      << msg.meta["yall::Prefix"] << "- ";
+  MetaFormattingBackend(
+    std::shared_ptr<LoggerBackend> toDecorate,
+    const std::string& pattern,
+    TimeStampFormatter timeFormatter = TimeStampFormatter::local()
+  ): decorated(toDecorate), layout(pattern, timeFormatter) {}
 
-    msg.sequence.emplace(msg.sequence.begin(), TypeAndValue{"yall::Formatted", ss.str()});
+  void take(LoggerMessage&& msg) override {
+    applyLayout(layout, msg);
     decorated->take(std::move(msg));
   }
+
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    for (auto it = first; it != last; ++it) {
+      applyLayout(layout, *it);
+    }
+    decorated->takeBatch(first, last);
+  }
 private:
   std::shared_ptr<LoggerBackend> decorated;
+  Layout layout;
 };
 
+inline void writeFields(std::ostream& os, const LoggerMessage& msg) {
+  for (auto&& v : msg.sequence) {
+    writeText(os, v);
+  }
+}
+
+inline void writeLine(std::ostream& os, const LoggerMessage& msg) {
+  writeFields(os, msg);
+  os << std::endl;
+}
+
 class StreamBackend : public LoggerBackend {
 public:
   explicit StreamBackend(std::shared_ptr<std::ostream> ostream) : stream(ostream) {}
 
   void take(LoggerMessage&& msg) override {
-    for (auto&& v : msg.sequence) {
-      *stream << v.value;
+    writeLine(*stream, msg);
+  }
+
+  void takeShared(const SharedMessage& msg) override {
+    writeLine(*stream, *msg);
+  }
+
+  // One flush for the whole batch.
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    for (auto it = first; it != last; ++it) {
+      writeFields(*stream, *it);
+      *stream << '\n';
     }
-    *stream << std::endl;
+    stream->flush();
   }
 private:
   std::shared_ptr<std::ostream> stream;
@@ -52,40 +95,139 @@ inline std::shared_ptr<std::ostream> globalStream(std::ostream& s) {
   return std::shared_ptr<std::ostream>(&s, detail::no_delete());
 }
 
+inline std::ostream& writeMeta(std::ostream& os, const MessageMeta& meta) {
+  os << "{yall::TimeStamp, " << toString(meta.timeStamp) << "} "
+    << "{yall::ThreadId, " << toString(meta.threadId) << "} ";
+  if (meta.hasPriority)
+    os << "{yall::Priority, " << toString(meta.priority) << "} ";
+  if (meta.prefix)
+    os << "{yall::Prefix, " << *meta.prefix << "} ";
+  for (const auto& kv : meta.user) {
+    os << '{' << kv.first << ", " << kv.second << "} ";
+  }
+  return os;
+}
+
 class DebugBackend : public LoggerBackend {
 public:
   void take(LoggerMessage&& msg) override {
-    for (const auto& kv : msg.meta) {
-      std::clog << '{' << kv.first << ", " << kv.second << "} ";
-    }
+    write(msg);
+  }
+
+  void takeShared(const SharedMessage& msg) override {
+    write(*msg);
+  }
+private:
+  void write(const LoggerMessage& msg) {
+    writeMeta(std::clog, msg.meta);
     for (const auto& kv : msg.sequence) {
-      std::clog << '{' << kv.type << ", " << kv.value << "} ";
+      std::clog << '{' << kv.type << ", ";
+      writeText(std::clog, kv) << "} ";
     }
     std::clog << std::endl;
   }
 };
 
+// Sequential dispatch runs the children one after another on the calling thread.
+// Parallel dispatch gives every child its own queue and thread, so that a slow
+// child does not hold back the others.
+enum class Dispatch {
+  Sequential,
+  Parallel
+};
+
+// Children get one shared, immutable message. Only children that modify it
+// (the ones not overriding takeShared) pay for a copy, and the last child gets
+// the message itself when nobody else kept a reference. A single child is
+// handed the message directly.
 class FanOutBackend : public LoggerBackend {
 public:
-  FanOutBackend() = default;
-  explicit FanOutBackend(const std::initializer_list<std::shared_ptr<LoggerBackend>>& iList)
-    : children(iList) {}
+  explicit FanOutBackend(Dispatch aDispatch = Dispatch::Sequential) : dispatch(aDispatch) {}
+  explicit FanOutBackend(
+    const std::initializer_list<std::shared_ptr<LoggerBackend>>& iList,
+    Dispatch aDispatch = Dispatch::Sequential
+  ) : dispatch(aDispatch) {
+    for (const auto& child : iList) {
+      add(child);
+    }
+  }
 
   void take(LoggerMessage&& msg) override {
     if (children.empty()) return;
-    int n = children.size();
-    const LoggerMessage& copy = msg;
-    for (int i = 0; i < n - 1; ++i) {
-      children[i]->take(LoggerMessage(copy));
+    if (dispatch == Dispatch::Parallel) {
+      takeShared(std::make_shared<const LoggerMessage>(std::move(msg)));
+      return;
+    }
+    const size_t n = children.size();
+    if (n == 1) {
+      children[0]->take(std::move(msg));
+      return;
+    }
+
+    auto shared = std::make_shared<LoggerMessage>(std::move(msg));
+    const SharedMessage view = shared;
+    for (size_t i = 0; i + 1 < n; ++i) {
+      children[i]->takeShared(view);
+    }
+    if (notKept(shared)) {
+      children[n - 1]->take(std::move(*shared));
+    } else {
+      children[n - 1]->takeShared(view);
+    }
+    // Hand the storage back to the caller, e.g. for the message pool.
+    if (notKept(shared))
+      msg = std::move(*shared);
+  }
+
+  void takeShared(const SharedMessage& msg) override {
+    if (dispatch == Dispatch::Parallel) {
+      for (auto& worker : workers) {
+        worker->push(SharedMessage(msg));
+      }
+      return;
+    }
+    for (auto& child : children) {
+      child->takeShared(msg);
     }
-    children[n-1]->take(std::move(msg));
   }
 
   void add(std::shared_ptr<LoggerBackend> lb) {
     children.push_back(lb);
+    if (dispatch == Dispatch::Parallel) {
+      workers.emplace_back(new detail::QueueWorker<SharedMessage>(
+        queueCapacity,
+        [lb](SharedMessage* first, SharedMessage* last) {
+          for (; first != last; ++first) {
+            lb->takeShared(*first);
+            first->reset();
+          }
+        }));
+    }
+  }
+
+  // Blocks until the children received everything given so far (parallel dispatch).
+  void flush() {
+    for (auto& worker : workers) {
+      worker->flush();
+    }
   }
 private:
+  static constexpr size_t queueCapacity = 1024;
+
+  // True when no child kept a reference besides our two. A child may have dropped
+  // its reference on another thread (e.g. an AsyncBackend or a parallel FanOutBackend):
+  // use_count() is a relaxed load, the fence makes the reads that thread did before
+  // its releasing decrement happen before we move from the message.
+  static bool notKept(const std::shared_ptr<LoggerMessage>& msg) {
+    if (msg.use_count() != 2)
+      return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+  }
+
+  Dispatch dispatch;
   std::vector<std::shared_ptr<LoggerBackend>> children;
+  std::vector<std::unique_ptr<detail::QueueWorker<SharedMessage>>> workers;
 };
 
 class SequencePrefixingBackend: public LoggerBackend {
@@ -94,7 +236,7 @@ public:
     decorated(toDecorate), prefix(prefix) {}
 
   void take(LoggerMessage&& msg) override {
-      msg.sequence.insert(msg.sequence.begin(), TypeAndValue{"yall::Prefix", prefix});
+      msg.sequence.insert(msg.sequence.begin(), TypeAndValue{tags::prefix(), prefix});
       decorated->take(std::move(msg));
     }
 private:
@@ -102,9 +244,229 @@ private:
   std::string prefix;
 };
 
+// Renders deferred captures in place for backends that read TypeAndValue::value directly.
+class CaptureEvaluatingBackend: public LoggerBackend {
+public:
+  explicit CaptureEvaluatingBackend(std::shared_ptr<LoggerBackend> toDecorate): decorated(toDecorate) {}
+
+  void take(LoggerMessage&& msg) override {
+    materialize(msg);
+    decorated->take(std::move(msg));
+  }
+
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    for (auto it = first; it != last; ++it) {
+      materialize(*it);
+    }
+    decorated->takeBatch(first, last);
+  }
+private:
+  std::shared_ptr<LoggerBackend> decorated;
+};
+
 class NullBackend : public LoggerBackend {
 public:
   void take(LoggerMessage&&) override {}
+  void takeShared(const SharedMessage&) override {}
+  void takeBatch(LoggerMessage*, LoggerMessage*) override {}
+};
+
+// What AsyncBackend does with a message that finds its queue full.
+// Messages without a priority count as Priority::Debug.
+struct OverflowPolicy {
+  enum class Action {
+    Block,       // wait for room, for at most timeout unless it is zero
+    DropNewest,  // drop the message that does not fit
+    DropOldest,  // drop the oldest queued messages to make room
+    DropBelow    // drop messages below minPriority, wait like Block for the others
+  };
+
+  Action action = Action::Block;
+  std::chrono::microseconds timeout = std::chrono::microseconds(0);
+  // Only for DropBelow. Priority::Error is kept whatever this says, and waits without timeout.
+  Priority minPriority = Priority::Warning;
+  // Dropped messages are counted by a record sent to the decorated backend
+  // at most this often; zero leaves the counting to AsyncBackend::dropped.
+  std::chrono::milliseconds reportInterval = std::chrono::milliseconds(1000);
+
+  static OverflowPolicy block(std::chrono::microseconds timeout = std::chrono::microseconds(0)) {
+    OverflowPolicy p;
+    p.timeout = timeout;
+    return p;
+  }
+
+  static OverflowPolicy dropNewest() {
+    OverflowPolicy p;
+    p.action = Action::DropNewest;
+    return p;
+  }
+
+  static OverflowPolicy dropOldest() {
+    OverflowPolicy p;
+    p.action = Action::DropOldest;
+    return p;
+  }
+
+  static OverflowPolicy dropBelow(Priority minPriority,
+                                  std::chrono::microseconds timeout = std::chrono::microseconds(0)) {
+    OverflowPolicy p;
+    p.action = Action::DropBelow;
+    p.minPriority = minPriority;
+    p.timeout = timeout;
+    return p;
+  }
+};
+
+// Moves messages into a bounded lock-free queue and hands them to the decorated
+// backend on a dedicated worker thread, as batches of whatever was queued.
+// Producers only wait (spinning) when the queue is full and the OverflowPolicy
+// says so. Destruction drains everything that was queued.
+class AsyncBackend : public LoggerBackend {
+public:
+  static constexpr size_t defaultCapacity = 8192;
+
+  explicit AsyncBackend(std::shared_ptr<LoggerBackend> toDecorate, size_t capacity = defaultCapacity,
+                        OverflowPolicy aPolicy = OverflowPolicy()):
+    decorated(toDecorate),
+    policy(aPolicy),
+    nextReport(std::chrono::steady_clock::now() + policy.reportInterval),
+    worker(capacity, [this](LoggerMessage* first, LoggerMessage* last) {
+      decorated->takeBatch(first, last);
+      for (; first != last; ++first) {
+        MessagePool::release(std::move(*first));
+      }
+    }, detail::QueueWorker<LoggerMessage>::defaultMaxBatch, [this]() {
+      if (policy.reportInterval.count() > 0)
+        report(false);
+    }) {}
+
+  // Reports what was dropped since the last report, unless reporting is off.
+  ~AsyncBackend() {
+    worker.flush();
+    if (policy.reportInterval.count() > 0)
+      report(true);
+  }
+
+  // A dropped message is left to the caller.
+  void take(LoggerMessage&& msg) override {
+    if (!worker.tryPush(std::move(msg)))
+      overflow(std::move(msg));
+  }
+
+  // Blocks until everything queued before the call reached the decorated backend.
+  void flush() {
+    worker.flush();
+  }
+
+  // Messages dropped so far, exact.
+  size_t dropped() const {
+    size_t ret = 0;
+    for (const auto& count : drops) {
+      ret += count.load(std::memory_order_relaxed);
+    }
+    return ret;
+  }
+
+  size_t dropped(Priority p) const {
+    return drops[static_cast<size_t>(p)].load(std::memory_order_relaxed);
+  }
+
+private:
+  enum : size_t { priorityCount = static_cast<size_t>(Priority::Error) + 1 };
+
+  void overflow(LoggerMessage&& msg) {
+    const Priority priority = msg.meta.priorityOrDebug();
+    switch (policy.action) {
+      case OverflowPolicy::Action::Block:
+        if (pushWaiting(std::move(msg), policy.timeout))
+          return;
+        break;
+      case OverflowPolicy::Action::DropNewest:
+        break;
+      case OverflowPolicy::Action::DropOldest: {
+        LoggerMessage oldest;
+        while (!worker.tryPush(std::move(msg))) {
+          if (worker.tryPopOldest(oldest)) {
+            countDrop(oldest.meta.priorityOrDebug());
+            MessagePool::release(std::move(oldest));
+          }
+        }
+        return;
+      }
+      case OverflowPolicy::Action::DropBelow:
+        if (priority == Priority::Error) {
+          worker.push(std::move(msg));
+          return;
+        }
+        if (priority >= policy.minPriority && pushWaiting(std::move(msg), policy.timeout))
+          return;
+        break;
+    }
+    countDrop(priority);
+  }
+
+  bool pushWaiting(LoggerMessage&& msg, std::chrono::microseconds timeout) {
+    if (timeout.count() == 0) {
+      worker.push(std::move(msg));
+      return true;
+    }
+    return worker.pushUntil(std::move(msg), std::chrono::steady_clock::now() + timeout);
+  }
+
+  void countDrop(Priority p) {
+    drops[static_cast<size_t>(p)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Sends a record of the messages dropped since the previous one, if any.
+  void report(bool now) {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    const auto time = std::chrono::steady_clock::now();
+    if (!now && time < nextReport)
+      return;
+    nextReport = time + policy.reportInterval;
+
+    size_t counts[priorityCount];
+    size_t total = 0;
+    for (size_t i = 0; i < priorityCount; ++i) {
+      const size_t count = drops[i].load(std::memory_order_relaxed);
+      counts[i] = count - reported[i];
+      reported[i] = count;
+      total += counts[i];
+    }
+    if (total == 0)
+      return;
+
+    std::string text = "yall: dropped " + toString(total) + " messages on a full queue (";
+    for (size_t i = 0; i < priorityCount; ++i) {
+      if (i != 0)
+        text += ", ";
+      text += priorityName(static_cast<Priority>(i));
+      text += ' ';
+      text += toString(counts[i]);
+    }
+    text += ')';
+
+    LoggerMessage msg;
+    msg.meta.timeStamp = std::chrono::system_clock::now();
+    msg.meta.threadId = std::this_thread::get_id();
+    msg.meta.setPriority(Priority::Warning);
+    msg.sequence.emplace_back(TypeAndValue{typeTag(text), std::move(text)});
+    try {
+      decorated->take(std::move(msg));
+    } catch (...) {
+      // Same as for a batch: nobody to report to from here.
+    }
+  }
+
+  std::shared_ptr<LoggerBackend> decorated;
+  const OverflowPolicy policy;
+
+  std::atomic<size_t> drops[priorityCount] = {};
+  std::mutex reportMutex;
+  size_t reported[priorityCount] = {};
+  std::chrono::steady_clock::time_point nextReport;
+
+  detail::QueueWorker<LoggerMessage> worker;
 };
 
 class BackendBuilder {
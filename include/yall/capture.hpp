@@ -0,0 +1,303 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/toString.hpp"
+#include "yall/numbers.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+
+namespace yall {
+
+// Deferred capture: copy the argument in its native form, leave the text for later.
+// Types without a native form below are converted eagerly with toString.
+
+template <typename T>
+typename std::enable_if<!(isNumberType<T>() && std::is_integral<T>::value)>::type
+capture(TypeAndValue& tv, const T& t) {
+  tv.value = toString(t);
+}
+
+inline void capture(TypeAndValue& tv, const char* str) {
+  tv.value = str;
+}
+
+inline void capture(TypeAndValue& tv, const std::string& str) {
+  tv.value = str;
+}
+
+inline void capture(TypeAndValue& tv, std::string&& str) {
+  tv.value = std::move(str);
+}
+
+inline void capture(TypeAndValue& tv, char ch) {
+  tv.captured.kind = CapturedValue::Kind::Character;
+  tv.captured.c = ch;
+}
+
+template <typename T>
+typename std::enable_if<isNumberType<T>() && std::is_integral<T>::value && std::is_signed<T>::value>::type
+capture(TypeAndValue& tv, const T& t) {
+  tv.captured.kind = CapturedValue::Kind::Signed;
+  tv.captured.i = t;
+}
+
+template <typename T>
+typename std::enable_if<isNumberType<T>() && std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+capture(TypeAndValue& tv, const T& t) {
+  tv.captured.kind = CapturedValue::Kind::Unsigned;
+  tv.captured.u = t;
+}
+
+// Kept as float, so that it prints as short as the float and not as the double it widens to.
+inline void capture(TypeAndValue& tv, float f) {
+  tv.captured.kind = CapturedValue::Kind::Float;
+  tv.captured.f = f;
+}
+
+inline void capture(TypeAndValue& tv, double d) {
+  tv.captured.kind = CapturedValue::Kind::Floating;
+  tv.captured.d = d;
+}
+
+// Rendering, done by the backends that actually need the text.
+
+inline void appendText(std::string& out, const TypeAndValue& tv) {
+  const auto& c = tv.captured;
+  char buf[maxNumberLength];
+  switch (c.kind) {
+    case CapturedValue::Kind::None: out += tv.value; return;
+    case CapturedValue::Kind::Signed: out.append(buf, formatDecimal(c.i, buf)); return;
+    case CapturedValue::Kind::Unsigned: out.append(buf, formatDecimal(c.u, buf)); return;
+    case CapturedValue::Kind::Floating: out.append(buf, formatShortest(c.d, buf)); return;
+    case CapturedValue::Kind::Float: out.append(buf, formatShortest(c.f, buf)); return;
+    case CapturedValue::Kind::Character: out += c.c; return;
+    case CapturedValue::Kind::StaticString: out += c.s; return;
+    case CapturedValue::Kind::Format: out += c.format->string; return;
+  }
+}
+
+inline std::string text(const TypeAndValue& tv) {
+  if (tv.captured.kind == CapturedValue::Kind::None)
+    return tv.value;
+  std::string ret;
+  appendText(ret, tv);
+  return ret;
+}
+
+inline std::ostream& writeText(std::ostream& os, const TypeAndValue& tv) {
+  const auto& c = tv.captured;
+  switch (c.kind) {
+    case CapturedValue::Kind::None: return os << tv.value;
+    case CapturedValue::Kind::Character: return os << c.c;
+    case CapturedValue::Kind::StaticString: return os << c.s;
+    case CapturedValue::Kind::Format: return os << c.format->string;
+    default: return os << text(tv);
+  }
+}
+
+namespace detail {
+
+inline bool isIntegerType(char type) {
+  return type == 'd' || type == 'x' || type == 'X' || type == 'o' || type == 'b';
+}
+
+inline bool isFloatingType(char type) {
+  return type == 'f' || type == 'e' || type == 'g';
+}
+
+// Appends body padded to spec.width. The first signLength characters of body
+// stay in front of the padding for the '=' alignment.
+inline void appendPadded(std::string& out, const char* body, size_t size, size_t signLength,
+                         const FmtSpec& spec, char defaultAlign) {
+  if (size >= spec.width) {
+    out.append(body, size);
+    return;
+  }
+  const size_t padding = spec.width - size;
+  const char fill = spec.fill ? spec.fill : (spec.zero ? '0' : ' ');
+  const char align = spec.align ? spec.align : (spec.zero ? '=' : defaultAlign);
+  switch (align) {
+    case '<':
+      out.append(body, size);
+      out.append(padding, fill);
+      break;
+    case '^':
+      out.append(padding / 2, fill);
+      out.append(body, size);
+      out.append(padding - padding / 2, fill);
+      break;
+    case '=':
+      out.append(body, signLength);
+      out.append(padding, fill);
+      out.append(body + signLength, size - signLength);
+      break;
+    default:
+      out.append(padding, fill);
+      out.append(body, size);
+  }
+}
+
+inline char signFor(bool negative, const FmtSpec& spec) {
+  if (negative) return '-';
+  return spec.sign == '+' || spec.sign == ' ' ? spec.sign : '\0';
+}
+
+inline void appendInteger(std::string& out, unsigned long long magnitude, bool negative, const FmtSpec& spec) {
+  unsigned base = 10;
+  const char* digits = "0123456789abcdef";
+  switch (spec.type) {
+    case 'x': base = 16; break;
+    case 'X': base = 16; digits = "0123456789ABCDEF"; break;
+    case 'o': base = 8; break;
+    case 'b': base = 2; break;
+  }
+
+  // 64 binary digits at most, or 20 decimal ones with separators.
+  char buf[72];
+  char* const end = buf + sizeof(buf);
+  char* it = end;
+  size_t count = 0;
+  do {
+    if (spec.thousands && count != 0 && count % 3 == 0)
+      *--it = ',';
+    *--it = digits[magnitude % base];
+    magnitude /= base;
+    ++count;
+  } while (magnitude != 0);
+
+  size_t signLength = 0;
+  if (char sign = signFor(negative, spec)) {
+    *--it = sign;
+    signLength = 1;
+  }
+  appendPadded(out, it, end - it, signLength, spec, '>');
+}
+
+// Without type and precision the shortest round-trip text is used, like without a spec.
+template <typename Float>
+void appendFloating(std::string& out, Float value, const FmtSpec& spec) {
+  // Precision is limited to 99 by the parser, so %f of the largest double fits.
+  char buf[512];
+  size_t size;
+  if (!spec.type && !spec.hasPrecision) {
+    char* it = buf;
+    if ((spec.sign == '+' || spec.sign == ' ') && !std::signbit(value))
+      *it++ = spec.sign;
+    size = formatShortest(value, it) - buf;
+  } else {
+    const char conversion = spec.type == 'e' || spec.type == 'g' ? spec.type : 'f';
+    const int precision = spec.hasPrecision ? int(spec.precision) : (spec.type == 'd' ? 0 : 6);
+
+    char format[6];
+    char* f = format;
+    *f++ = '%';
+    if (spec.sign == '+' || spec.sign == ' ')
+      *f++ = spec.sign;
+    *f++ = '.';
+    *f++ = '*';
+    *f++ = conversion;
+    *f = '\0';
+    const int n = std::snprintf(buf, sizeof(buf), format, precision, double(value));
+    if (n < 0)
+      return;
+    size = std::min(size_t(n), sizeof(buf) - 1);
+  }
+  const size_t signLength = (buf[0] == '-' || buf[0] == '+' || buf[0] == ' ') ? 1 : 0;
+
+  if (!spec.thousands) {
+    appendPadded(out, buf, size, signLength, spec, '>');
+    return;
+  }
+
+  const char* const bufEnd = buf + size;
+  const char* digits = buf + signLength;
+  const char* digitsEnd = digits;
+  while (digitsEnd != bufEnd && '0' <= *digitsEnd && *digitsEnd <= '9')
+    ++digitsEnd;
+
+  char grouped[sizeof(buf) + sizeof(buf) / 3];
+  char* it = std::copy(buf, buf + signLength, grouped);
+  for (const char* d = digits; d != digitsEnd; ++d) {
+    if (d != digits && (digitsEnd - d) % 3 == 0)
+      *it++ = ',';
+    *it++ = *d;
+  }
+  it = std::copy(digitsEnd, bufEnd, it);
+  appendPadded(out, grouped, it - grouped, signLength, spec, '>');
+}
+
+inline void appendString(std::string& out, const char* str, size_t size, const FmtSpec& spec) {
+  if (spec.hasPrecision)
+    size = std::min(size, size_t(spec.precision));
+  appendPadded(out, str, size, 0, spec, '<');
+}
+
+} // namespace detail
+
+// Renders the field as requested by a "${n:spec}" placeholder. Radix, sign and
+// precision apply to native values, which the logger keeps for the numbers and
+// characters passed to a format string in either capture mode; text only gets
+// padded or truncated. A floating value given an integer type prints fixed:
+// 'd' without decimals, the radix types x, X, o and b like 'f'.
+inline void appendText(std::string& out, const TypeAndValue& tv, const detail::FmtSpec& spec) {
+  if (spec.empty()) {
+    appendText(out, tv);
+    return;
+  }
+  const auto& c = tv.captured;
+  switch (c.kind) {
+    case CapturedValue::Kind::Signed:
+      if (detail::isFloatingType(spec.type))
+        detail::appendFloating(out, double(c.i), spec);
+      else
+        detail::appendInteger(out, c.i < 0 ? 0ull - static_cast<unsigned long long>(c.i) : c.i, c.i < 0, spec);
+      return;
+    case CapturedValue::Kind::Unsigned:
+      if (detail::isFloatingType(spec.type))
+        detail::appendFloating(out, double(c.u), spec);
+      else
+        detail::appendInteger(out, c.u, false, spec);
+      return;
+    case CapturedValue::Kind::Floating:
+      detail::appendFloating(out, c.d, spec);
+      return;
+    case CapturedValue::Kind::Float:
+      detail::appendFloating(out, c.f, spec);
+      return;
+    case CapturedValue::Kind::Character:
+      if (detail::isIntegerType(spec.type))
+        detail::appendInteger(out, static_cast<unsigned char>(c.c), false, spec);
+      else
+        detail::appendString(out, &c.c, 1, spec);
+      return;
+    case CapturedValue::Kind::StaticString:
+      detail::appendString(out, c.s, strlen(c.s), spec);
+      return;
+    case CapturedValue::Kind::Format:
+      detail::appendString(out, c.format->string, strlen(c.format->string), spec);
+      return;
+    case CapturedValue::Kind::None:
+      detail::appendString(out, tv.value.data(), tv.value.size(), spec);
+      return;
+  }
+}
+
+// Turns captured fields into plain text, for backends that only read TypeAndValue::value.
+inline void materialize(TypeAndValue& tv) {
+  if (tv.captured.kind == CapturedValue::Kind::None)
+    return;
+  tv.value = text(tv);
+  tv.captured = CapturedValue();
+}
+
+inline void materialize(LoggerMessage& msg) {
+  for (auto& tv : msg.sequence) {
+    materialize(tv);
+  }
+}
+
+} // namespace yall
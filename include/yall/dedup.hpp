@@ -0,0 +1,254 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/toString.hpp"
+#include "yall/fmt.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace yall {
+
+namespace detail {
+
+inline void hashCombine(size_t& h, size_t v) {
+  h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+}
+
+inline size_t hashOf(const CapturedValue& c) {
+  using Kind = CapturedValue::Kind;
+  switch (c.kind) {
+    case Kind::None: return 0;
+    case Kind::Signed: return std::hash<long long>()(c.i);
+    case Kind::Unsigned: return std::hash<unsigned long long>()(c.u);
+    case Kind::Floating: return std::hash<double>()(c.d);
+    case Kind::Float: return std::hash<float>()(c.f);
+    case Kind::Character: return std::hash<char>()(c.c);
+    case Kind::StaticString: return std::hash<const void*>()(c.s);
+    case Kind::Format: return std::hash<const void*>()(c.format);
+  }
+  return 0;
+}
+
+// Everything but when and on which thread the message was made. Deferred
+// fields hash in native form, a format string by its interned layout.
+inline size_t hashContent(const LoggerMessage& msg) {
+  size_t h = std::hash<const void*>()(msg.meta.prefix);
+  hashCombine(h, msg.meta.hasPriority ? static_cast<size_t>(msg.meta.priority) + 1 : 0);
+  for (const auto& e : msg.meta.user) {
+    hashCombine(h, std::hash<const void*>()(e.first.id()));
+    hashCombine(h, std::hash<std::string>()(e.second));
+  }
+  for (const auto& tv : msg.sequence) {
+    hashCombine(h, std::hash<const void*>()(tv.type.id()));
+    hashCombine(h, std::hash<std::string>()(tv.value));
+    hashCombine(h, static_cast<size_t>(tv.captured.kind));
+    hashCombine(h, hashOf(tv.captured));
+  }
+  return h;
+}
+
+}
+
+// Collapses repeats: a message equal to one passed on less than a window ago
+// is dropped and counted. When the window of the first occurrence is over, or
+// its slot is needed by another message, the repeats are reported as a copy of
+// the message led by "repeated N times over T ms: ", with a format string
+// already evaluated.
+//
+// Messages are told apart by a hash of their content only, kept in a small set
+// associative table, so the cost per message is hashing its fields and a few
+// compares. Two different messages with equal hashes count as repeats, the
+// second one is dropped. A message finding its set full takes the slot of the
+// one repeated least recently. Belongs in front of the formatting backends,
+// which turn the timestamp into text.
+//
+// Time is taken from the message timestamps, there is no timer: a report is
+// made when a later message arrives, on reportExpired() and on flush(). When
+// the messages stop, the counts wait until then, and a crash loses them. Call
+// reportExpired() periodically where reports must not wait for the next
+// message, and flush() before shutting down.
+class DedupBackend: public LoggerBackend {
+public:
+  enum : size_t { defaultSlots = 64, ways = 4 };
+
+  explicit DedupBackend(std::shared_ptr<LoggerBackend> toDecorate,
+                        std::chrono::milliseconds aWindow = std::chrono::milliseconds(1000),
+                        size_t slots = defaultSlots)
+    : decorated(toDecorate), window(aWindow), table(roundUp(slots < ways ? ways : slots)),
+      setMask(table.size() / ways - 1), nextExpiry(TimeStamp::max()) {}
+
+  DedupBackend(const DedupBackend&) = delete;
+  DedupBackend& operator=(const DedupBackend&) = delete;
+
+  ~DedupBackend() {
+    flush();
+  }
+
+  void take(LoggerMessage&& msg) override {
+    std::vector<LoggerMessage> reports;
+    const bool pass = admit(msg, &msg, reports);
+    forward(reports);
+    if (pass)
+      decorated->take(std::move(msg));
+  }
+
+  void takeShared(const SharedMessage& msg) override {
+    std::vector<LoggerMessage> reports;
+    const bool pass = admit(*msg, nullptr, reports);
+    forward(reports);
+    if (pass)
+      decorated->takeShared(msg);
+  }
+
+  // Messages passing are moved to the front and handed on in runs, with the
+  // reports in between where they belong.
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    std::vector<LoggerMessage> reports;
+    LoggerMessage* pending = first;
+    LoggerMessage* kept = first;
+    for (auto it = first; it != last; ++it) {
+      const bool pass = admit(*it, it, reports);
+      if (!reports.empty()) {
+        if (kept != pending)
+          decorated->takeBatch(pending, kept);
+        pending = kept;
+        forward(reports);
+      }
+      if (!pass)
+        continue;
+      if (kept != it)
+        *kept = std::move(*it);
+      ++kept;
+    }
+    if (kept != pending)
+      decorated->takeBatch(pending, kept);
+  }
+
+  // Reports the repeats of the messages whose window is over at now.
+  void reportExpired(TimeStamp now = std::chrono::system_clock::now()) {
+    std::vector<LoggerMessage> reports;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (now >= nextExpiry)
+        expire(now, reports);
+    }
+    forward(reports);
+  }
+
+  // Reports the repeats counted so far and forgets every message.
+  void flush() {
+    std::vector<LoggerMessage> reports;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto& slot : table)
+        close(slot, reports);
+      nextExpiry = TimeStamp::max();
+    }
+    byTime(reports);
+    forward(reports);
+  }
+
+private:
+  struct Slot {
+    bool used = false;
+    size_t hash = 0;
+    size_t repeats = 0;
+    TimeStamp first;
+    TimeStamp last;
+    LoggerMessage sample;  // the first repeat, the report is made of it
+  };
+
+  static size_t roundUp(size_t n) {
+    size_t ret = 1;
+    while (ret < n) ret <<= 1;
+    return ret;
+  }
+
+  // The message may be moved from when toMove is set and the call returns false.
+  bool admit(const LoggerMessage& msg, LoggerMessage* toMove, std::vector<LoggerMessage>& reports) {
+    const size_t hash = detail::hashContent(msg);
+    const TimeStamp now = msg.meta.timeStamp;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (now >= nextExpiry)
+      expire(now, reports);
+
+    Slot* const set = &table[(hash & setMask) * ways];
+    Slot* victim = set;
+    for (Slot* way = set; way != set + ways; ++way) {
+      if (way->used && way->hash == hash) {
+        if (way->repeats++ == 0)
+          way->sample = toMove ? std::move(*toMove) : msg;
+        way->last = now;
+        return false;
+      }
+      if (victim->used && (!way->used || way->last < victim->last))
+        victim = way;
+    }
+    Slot& slot = *victim;
+    close(slot, reports);
+    slot.used = true;
+    slot.hash = hash;
+    slot.first = slot.last = now;
+    if (now + window < nextExpiry)
+      nextExpiry = now + window;
+    return true;
+  }
+
+  void expire(TimeStamp now, std::vector<LoggerMessage>& reports) {
+    nextExpiry = TimeStamp::max();
+    for (auto& slot : table) {
+      if (!slot.used)
+        continue;
+      if (now - slot.first >= window)
+        close(slot, reports);
+      else if (slot.first + window < nextExpiry)
+        nextExpiry = slot.first + window;
+    }
+    byTime(reports);
+  }
+
+  void close(Slot& slot, std::vector<LoggerMessage>& reports) {
+    if (slot.used && slot.repeats != 0) {
+      const auto span = std::chrono::duration_cast<std::chrono::milliseconds>(slot.last - slot.first);
+      std::string text = "repeated " + toString(slot.repeats) + " times over "
+        + toString(span.count() > 0 ? span.count() : 0) + " ms: ";
+      LoggerMessage report = std::move(slot.sample);
+      report.meta.timeStamp = slot.last;
+      // In front of a format string the count would hide it from FmtEvaluatingBackend.
+      evaluateFmt(report);
+      report.sequence.insert(report.sequence.begin(), TypeAndValue{typeTag(text), std::move(text)});
+      reports.push_back(std::move(report));
+    }
+    slot.used = false;
+    slot.repeats = 0;
+  }
+
+  // Slots are visited by hash, reports of one sweep go out in the order of their last repeat.
+  static void byTime(std::vector<LoggerMessage>& reports) {
+    std::stable_sort(reports.begin(), reports.end(), [](const LoggerMessage& a, const LoggerMessage& b) {
+      return a.meta.timeStamp < b.meta.timeStamp;
+    });
+  }
+
+  void forward(std::vector<LoggerMessage>& reports) {
+    for (auto& report : reports)
+      decorated->take(std::move(report));
+    reports.clear();
+  }
+
+  std::shared_ptr<LoggerBackend> decorated;
+  const std::chrono::milliseconds window;
+  std::mutex mutex;
+  std::vector<Slot> table;  // sets of consecutive ways
+  const size_t setMask;
+  TimeStamp nextExpiry;  // earliest end of a window in the table
+};
+
+} // namespace yall
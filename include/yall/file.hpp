@@ -0,0 +1,286 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/capture.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace yall {
+
+// When FileBackend hands its buffers to the kernel and when it starts a new file.
+// A zero value disables the respective trigger.
+struct FilePolicy {
+  // Wake the flusher once this many bytes are waiting.
+  size_t flushBytes = 64 * 1024;
+  // Write out whatever is waiting at least this often.
+  std::chrono::milliseconds flushInterval = std::chrono::milliseconds(1000);
+  // Messages of this priority or above are written before take() returns.
+  Priority flushPriority = Priority::Error;
+  // At most this many buffers wait for the disk, messages finding them all full are
+  // dropped and counted (see FileBackend::dropped). Zero means no limit.
+  size_t maxBuffers = 64;
+
+  // Rotation happens between batches, so a file may exceed rotateBytes by one batch.
+  size_t rotateBytes = 0;
+  std::chrono::seconds rotateInterval = std::chrono::seconds(0);
+  // Rotated files are kept as path.1 (newest) up to path.keepFiles.
+  size_t keepFiles = 5;
+};
+
+// Formats messages into reusable buffers and writes them out in batches with
+// writev. Writers only take a short lock to append their line; the writes
+// and rotation happen on a flusher thread, on flush() and on destruction.
+// Only urgent messages (see FilePolicy::flushPriority) write on the caller's thread.
+// A failed write loses its batch, see writeErrors().
+class FileBackend : public LoggerBackend {
+public:
+  enum : size_t { bufferSize = 16 * 1024 };
+
+  explicit FileBackend(std::string aPath, FilePolicy aPolicy = FilePolicy())
+    : path(std::move(aPath)), policy(aPolicy) {
+    if (!openFile())
+      throw std::system_error(errno, std::generic_category(), "yall: cannot open " + path);
+    flusher = std::thread(&FileBackend::run, this);
+  }
+
+  FileBackend(const FileBackend&) = delete;
+  FileBackend& operator=(const FileBackend&) = delete;
+
+  ~FileBackend() {
+    {
+      std::lock_guard<std::mutex> lock(bufferMutex);
+      stopping = true;
+    }
+    wakeUp.notify_one();
+    flusher.join();
+    flush();
+    if (fd >= 0)
+      ::close(fd);
+  }
+
+  void take(LoggerMessage&& msg) override {
+    write(&msg, &msg + 1);
+  }
+
+  void takeShared(const SharedMessage& msg) override {
+    write(msg.get(), msg.get() + 1);
+  }
+
+  // The whole batch goes in under one lock.
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    write(first, last);
+  }
+
+  // Writes out everything taken so far.
+  void flush() {
+    std::lock_guard<std::mutex> lock(fileMutex);
+    writeOut();
+  }
+
+  // Messages dropped because FilePolicy::maxBuffers were waiting.
+  size_t dropped() const {
+    return drops.load(std::memory_order_relaxed);
+  }
+
+  // Batches lost to failed writes.
+  size_t writeErrors() const {
+    return errors.load(std::memory_order_relaxed);
+  }
+
+private:
+  void write(const LoggerMessage* first, const LoggerMessage* last) {
+    bool urgent = false;
+    bool due;
+    {
+      std::lock_guard<std::mutex> lock(bufferMutex);
+      for (auto msg = first; msg != last; ++msg) {
+        if (!room()) {
+          drops.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        urgent = urgent || (msg->meta.hasPriority && msg->meta.priority >= policy.flushPriority);
+        auto& buffer = current();
+        const size_t before = buffer.size();
+        for (const auto& tv : msg->sequence) {
+          appendText(buffer, tv);
+        }
+        buffer += '\n';
+        pendingBytes += buffer.size() - before;
+      }
+      due = thresholdReached();
+    }
+    if (urgent)
+      flush();
+    else if (due)
+      wakeUp.notify_one();
+  }
+
+  // Called with bufferMutex held.
+  bool room() const {
+    return policy.maxBuffers == 0 || filled.size() < policy.maxBuffers
+      || filled.back().size() < bufferSize;
+  }
+
+  // Called with bufferMutex held.
+  std::string& current() {
+    if (filled.empty() || filled.back().size() >= bufferSize) {
+      if (spare.empty()) {
+        filled.emplace_back();
+        filled.back().reserve(bufferSize);
+      } else {
+        filled.push_back(std::move(spare.back()));
+        spare.pop_back();
+      }
+    }
+    return filled.back();
+  }
+
+  bool thresholdReached() const {
+    return policy.flushBytes != 0 && pendingBytes >= policy.flushBytes;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(bufferMutex);
+    auto due = [this]() { return stopping || thresholdReached(); };
+    while (!stopping) {
+      if (policy.flushInterval.count() > 0)
+        wakeUp.wait_for(lock, policy.flushInterval, due);
+      else
+        wakeUp.wait(lock, due);
+      if (stopping)
+        break;
+      lock.unlock();
+      flush();
+      lock.lock();
+    }
+  }
+
+  // Called with fileMutex held. Writers keep appending to fresh buffers meanwhile.
+  void writeOut() {
+    {
+      std::lock_guard<std::mutex> lock(bufferMutex);
+      std::swap(filled, writing);
+      pendingBytes = 0;
+    }
+    if (fd < 0)
+      openFile();
+    writeAll();
+    if (rotationDue())
+      rotate();
+    {
+      std::lock_guard<std::mutex> lock(bufferMutex);
+      for (auto& buffer : writing) {
+        buffer.clear();
+        spare.push_back(std::move(buffer));
+      }
+    }
+    writing.clear();
+  }
+
+  void writeAll() {
+    iov.clear();
+    for (auto& buffer : writing) {
+      if (!buffer.empty())
+        iov.push_back(iovec{&buffer[0], buffer.size()});
+    }
+    size_t first = 0;
+    while (fd >= 0 && first < iov.size()) {
+      const int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+      ssize_t written = ::writev(fd, &iov[first], count);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      fileBytes += static_cast<size_t>(written);
+      size_t left = static_cast<size_t>(written);
+      while (left > 0 && left >= iov[first].iov_len) {
+        left -= iov[first].iov_len;
+        ++first;
+      }
+      if (left > 0) {
+        iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+        iov[first].iov_len -= left;
+      }
+    }
+  }
+
+  bool rotationDue() const {
+    if (fileBytes == 0)
+      return false;
+    if (policy.rotateBytes != 0 && fileBytes >= policy.rotateBytes)
+      return true;
+    return policy.rotateInterval.count() > 0
+      && std::chrono::steady_clock::now() - openedAt >= policy.rotateInterval;
+  }
+
+  void rotate() {
+    ::close(fd);
+    fd = -1;
+    if (policy.keepFiles == 0) {
+      ::unlink(path.c_str());
+    } else {
+      for (size_t i = policy.keepFiles; i > 1; --i) {
+        std::rename(rotatedName(i - 1).c_str(), rotatedName(i).c_str());
+      }
+      std::rename(path.c_str(), rotatedName(1).c_str());
+    }
+    openFile();
+  }
+
+  std::string rotatedName(size_t i) const {
+    return path + '.' + std::to_string(i);
+  }
+
+  bool openFile() {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+      return false;
+    const off_t size = ::lseek(fd, 0, SEEK_END);
+    fileBytes = size > 0 ? static_cast<size_t>(size) : 0;
+    openedAt = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  const std::string path;
+  const FilePolicy policy;
+
+  // Guards the buffers being filled by writers.
+  std::mutex bufferMutex;
+  std::condition_variable wakeUp;
+  std::vector<std::string> filled;
+  std::vector<std::string> spare;
+  size_t pendingBytes = 0;
+  bool stopping = false;
+  std::atomic<size_t> drops{0};
+  std::atomic<size_t> errors{0};
+
+  // Guards the file and the buffers being written.
+  std::mutex fileMutex;
+  std::vector<std::string> writing;
+  std::vector<iovec> iov;
+  int fd = -1;
+  size_t fileBytes = 0;
+  std::chrono::steady_clock::time_point openedAt;
+
+  std::thread flusher;
+};
+
+} // namespace yall
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/priority.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace yall {
+
+// Which messages pass, decided by logger name (the prefix) and priority.
+//
+//   "db.* >= warning, net.http.* >= debug, net.http >= info, * >= info"
+//
+// "a.b" matches the name a.b only, "a.b.*" matches a.b and all names below
+// it, "*" matches everything, also messages without a prefix. The most
+// specific rule wins, for a.b itself "a.b" before "a.b.*", a later rule
+// replaces an equal earlier one, and a message no rule matches passes.
+// "off" as priority drops whatever the rule matches.
+// Messages without a priority count as debug. Rules see the full name, i.e.
+// the loggers of a PrefixedLogger tree are "root.db" and the like.
+//
+// The rules are compiled once into a trie over the name segments. Every node
+// carries the decision for its own name and the one for names below it that
+// have no node, so a message is decided in a single walk along its prefix.
+class FilterRules {
+public:
+  explicit FilterRules(const std::string& rules) {
+    compile(rules);
+  }
+
+  bool passes(const LoggerMessage& msg) const {
+    return passes(msg.meta.prefix, msg.meta.priorityOrDebug());
+  }
+
+  bool passes(const std::string* prefix, Priority priority) const {
+    return static_cast<unsigned char>(priority) >= threshold(prefix);
+  }
+
+private:
+  enum : unsigned char { off = static_cast<unsigned char>(Priority::Error) + 1 };
+
+  struct Node {
+    std::string segment;
+    // Children of a node are consecutive and sorted by segment.
+    size_t firstChild;
+    size_t childCount;
+    unsigned char exact;  // for the name of the node
+    unsigned char below;  // for names below it without a node of their own
+  };
+
+  unsigned char threshold(const std::string* prefix) const {
+    const Node* node = &nodes[0];
+    if (!prefix)
+      return node->exact;
+
+    const char* it = prefix->data();
+    const char* const end = it + prefix->size();
+    for (;;) {
+      const char* dot = std::find(it, end, '.');
+      const Node* child = findChild(*node, it, dot - it);
+      if (!child)
+        return node->below;
+      node = child;
+      if (dot == end)
+        return node->exact;
+      it = dot + 1;
+    }
+  }
+
+  const Node* findChild(const Node& node, const char* segment, size_t length) const {
+    auto first = nodes.begin() + node.firstChild;
+    auto last = first + node.childCount;
+    auto found = std::lower_bound(first, last, 0, [segment, length](const Node& n, int) {
+      return n.segment.compare(0, std::string::npos, segment, length) < 0;
+    });
+    if (found == last || found->segment.compare(0, std::string::npos, segment, length) != 0)
+      return nullptr;
+    return &*found;
+  }
+
+  // Rules are first collected in a tree of maps, then laid out breadth first.
+  // The name of a node takes its exact rule, else its own "name.*" rule.
+  struct Draft {
+    std::map<std::string, Draft> children;
+    int exact = -1;  // "name"
+    int below = -1;  // "name.*"
+  };
+
+  void compile(const std::string& rules) {
+    Draft root;
+    size_t begin = 0;
+    while (begin <= rules.size()) {
+      size_t comma = rules.find(',', begin);
+      if (comma == std::string::npos)
+        comma = rules.size();
+      addRule(root, trim(rules.substr(begin, comma - begin)));
+      begin = comma + 1;
+    }
+
+    const unsigned char all = root.below >= 0 ? static_cast<unsigned char>(root.below) : 0;
+    nodes.push_back(Node{std::string(), 0, 0, all, all});
+    std::vector<const Draft*> drafts{&root};
+    for (size_t i = 0; i < drafts.size(); ++i) {
+      nodes[i].firstChild = nodes.size();
+      nodes[i].childCount = drafts[i]->children.size();
+      for (const auto& child : drafts[i]->children) {
+        const Draft& d = child.second;
+        const unsigned char below = d.below >= 0 ? static_cast<unsigned char>(d.below) : nodes[i].below;
+        const unsigned char exact = d.exact >= 0 ? static_cast<unsigned char>(d.exact) : below;
+        nodes.push_back(Node{child.first, 0, 0, exact, below});
+        drafts.push_back(&d);
+      }
+    }
+  }
+
+  static void addRule(Draft& root, const std::string& rule) {
+    if (rule.empty())
+      return;
+    const size_t op = rule.find(">=");
+    if (op == std::string::npos)
+      throw std::invalid_argument("Filter rule without '>=': " + rule);
+    const std::string pattern = trim(rule.substr(0, op));
+    const int level = parseLevel(trim(rule.substr(op + 2)), rule);
+
+    if (pattern == "*") {
+      root.below = level;
+      return;
+    }
+
+    Draft* node = &root;
+    size_t begin = 0;
+    for (;;) {
+      const size_t dot = pattern.find('.', begin);
+      const std::string segment = pattern.substr(begin, dot == std::string::npos ? std::string::npos : dot - begin);
+      if (segment == "*" && dot == std::string::npos && node != &root) {
+        node->below = level;
+        return;
+      }
+      if (segment.empty() || segment.find('*') != std::string::npos)
+        throw std::invalid_argument("Invalid name in filter rule: " + rule);
+      node = &node->children[segment];
+      if (dot == std::string::npos) {
+        node->exact = level;
+        return;
+      }
+      begin = dot + 1;
+    }
+  }
+
+  static int parseLevel(const std::string& name, const std::string& rule) {
+    if (name == "off")
+      return off;
+    for (unsigned char p = 0; p < off; ++p) {
+      if (name == priorityName(static_cast<Priority>(p)))
+        return p;
+    }
+    throw std::invalid_argument("Unknown priority in filter rule: " + rule);
+  }
+
+  static std::string trim(const std::string& s) {
+    const size_t first = s.find_first_not_of(" \t");
+    if (first == std::string::npos)
+      return std::string();
+    return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+  }
+
+  std::vector<Node> nodes;
+};
+
+// Passes on the messages the rules let through; the others are left to the caller.
+//
+// The rules can be replaced while messages flow. Readers only load a pointer,
+// so every set of rules given is kept until the backend goes, as a message in
+// flight may still be judged by it. Giving the same text again reuses the set
+// compiled for it: memory grows with the number of distinct sets, not with
+// the number of changes.
+class FilteringBackend: public LoggerBackend {
+public:
+  FilteringBackend(std::shared_ptr<LoggerBackend> toDecorate, const std::string& rules):
+    decorated(toDecorate), current(nullptr) {
+    setRules(rules);
+  }
+
+  // Invalid rules throw before anything is replaced.
+  void setRules(const std::string& rules) {
+    std::lock_guard<std::mutex> lock(rulesMutex);
+    auto found = owned.find(rules);
+    if (found == owned.end()) {
+      std::unique_ptr<const FilterRules> compiled(new FilterRules(rules));
+      found = owned.emplace(rules, std::move(compiled)).first;
+    }
+    current.store(found->second.get(), std::memory_order_release);
+  }
+
+  void take(LoggerMessage&& msg) override {
+    if (rules().passes(msg))
+      decorated->take(std::move(msg));
+  }
+
+  void takeShared(const SharedMessage& msg) override {
+    if (rules().passes(*msg))
+      decorated->takeShared(msg);
+  }
+
+  // Moves the messages that pass to the front and hands on just those.
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    const FilterRules& r = rules();
+    LoggerMessage* kept = first;
+    for (auto it = first; it != last; ++it) {
+      if (!r.passes(*it))
+        continue;
+      if (kept != it)
+        *kept = std::move(*it);
+      ++kept;
+    }
+    if (kept != first)
+      decorated->takeBatch(first, kept);
+  }
+
+private:
+  const FilterRules& rules() const {
+    return *current.load(std::memory_order_acquire);
+  }
+
+  std::shared_ptr<LoggerBackend> decorated;
+  std::atomic<const FilterRules*> current;
+  std::mutex rulesMutex;
+  std::map<std::string, std::unique_ptr<const FilterRules>> owned;  // by rule text
+};
+
+} // namespace yall
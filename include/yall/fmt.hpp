@@ -5,8 +5,10 @@
 #include <utility>
 #include <cassert>
 #include <cstring>
+#include <memory>
 
 #include "yall/types.hpp"
+#include "yall/capture.hpp"
 
 namespace yall {
 namespace detail {
@@ -22,7 +24,10 @@ struct Fmt : public FmtBase {
   Fmt(const char* s) : string(s) {
     assert(std::count(string, string + strlen(s), '$') == C);
   }
+  explicit Fmt(const FmtLayout& aLayout) : string(aLayout.string), layout(&aLayout) {}
+
   const char* string;
+  const FmtLayout* layout = nullptr;
 };
 
 
@@ -32,8 +37,20 @@ std::string toString(const ::yall::detail::Fmt<C>& t) {
 }
 
 template<size_t C>
-std::string typeString(const ::yall::detail::Fmt<C>& t) {
-  return "yall::Fmt";
+TypeTag typeTag(const ::yall::detail::Fmt<C>&) {
+  return tags::fmt();
+}
+
+// Format strings are expected to be static, only the pointer is kept.
+template<size_t C>
+void capture(TypeAndValue& tv, const ::yall::detail::Fmt<C>& t) {
+  if (t.layout) {
+    tv.captured.kind = CapturedValue::Kind::Format;
+    tv.captured.format = t.layout;
+  } else {
+    tv.captured.kind = CapturedValue::Kind::StaticString;
+    tv.captured.s = t.string;
+  }
 }
 
 
@@ -53,28 +70,113 @@ constexpr size_t readNumber(const char* start, const char* end) {
   return ret;
 }
 
-constexpr std::pair<size_t, const char*> readPlaceholder(const char* it) {
+constexpr bool isDigit(char c) {
+  return '0' <= c && c <= '9';
+}
+
+constexpr bool isAlign(char c) {
+  return c == '<' || c == '>' || c == '^' || c == '=';
+}
+
+constexpr bool isSpecType(char c) {
+  return c == 'd' || c == 'x' || c == 'X' || c == 'o' || c == 'b'
+    || c == 'f' || c == 'e' || c == 'g' || c == 's';
+}
+
+// [[fill]align][sign][0][width][,][.precision][type], e.g. "*^12", "+08.3f", ",d", "#>4x".
+constexpr FmtSpec readSpec(const char* it, const char* end) {
+  FmtSpec spec{};
+  if (end - it >= 2 && isAlign(it[1])) {
+    spec.fill = it[0];
+    spec.align = it[1];
+    it += 2;
+  } else if (it != end && isAlign(*it)) {
+    spec.align = *it++;
+  }
+
+  if (it != end && (*it == '+' || *it == '-' || *it == ' '))
+    spec.sign = *it++;
+
+  if (it != end && *it == '0') {
+    spec.zero = true;
+    ++it;
+  }
+
+  while (it != end && isDigit(*it)) {
+    spec.width = spec.width * 10 + (*it++ - '0');
+    if (spec.width > 999)
+      throw std::logic_error("Width is too large");
+  }
+
+  if (it != end && *it == ',') {
+    spec.thousands = true;
+    ++it;
+  }
+
+  if (it != end && *it == '.') {
+    ++it;
+    if (it == end || !isDigit(*it))
+      throw std::logic_error("Expected precision after '.'");
+    spec.hasPrecision = true;
+    while (it != end && isDigit(*it)) {
+      spec.precision = spec.precision * 10 + (*it++ - '0');
+      if (spec.precision > 99)
+        throw std::logic_error("Precision is too large");
+    }
+  }
+
+  if (it != end && isSpecType(*it))
+    spec.type = *it++;
+
+  if (it != end)
+    throw std::logic_error("Invalid format spec");
+  if (spec.thousands && spec.type != '\0' && spec.type != 'd' && spec.type != 'f')
+    throw std::logic_error("Thousands separator needs a decimal type");
+  if (spec.hasPrecision && (spec.type == 'd' || spec.type == 'x' || spec.type == 'X'
+                            || spec.type == 'o' || spec.type == 'b'))
+    throw std::logic_error("Precision is not allowed for integer types");
+
+  return spec;
+}
+
+struct Placeholder {
+  size_t index;
+  FmtSpec spec;
+  const char* next;
+};
+
+// Reads "{n}" or "{n:spec}", it points just past the '$'.
+constexpr Placeholder readPlaceholderWithSpec(const char* it) {
   if (*it != '{')
     throw std::logic_error("Expected '{' after '$'");
-    ++it;
+  ++it;
 
-    auto start = it;
-    while (*it != ':' && *it != '}' && *it != '\0') ++it;
+  auto start = it;
+  while (*it != ':' && *it != '}' && *it != '\0') ++it;
 
-    if (*it == '\0')
-      throw std::logic_error("Closing brace not found");
+  if (*it == '\0')
+    throw std::logic_error("Closing brace not found");
 
-    auto end = it;
-    auto ret = readNumber(start, end);
+  auto index = readNumber(start, it);
 
+  FmtSpec spec{};
+  if (*it == ':') {
+    auto specStart = ++it;
     while (*it != '}' && *it != '\0') ++it;
 
     if (*it == '\0')
       throw std::logic_error("Closing brace not found");
 
-    ++it;
+    spec = readSpec(specStart, it);
+  }
+  ++it;
 
-    return std::make_pair(ret, it);
+  return Placeholder{index, spec, it};
+}
+
+constexpr std::pair<size_t, const char*> readPlaceholder(const char* it) {
+  auto placeholder = readPlaceholderWithSpec(it);
+  return std::make_pair(placeholder.index, placeholder.next);
 }
 
 #if __cplusplus < 199711L
@@ -113,37 +215,135 @@ constexpr size_t placeholderCount(const char* fmt) {
 
 #endif
 
+constexpr size_t segmentCount(const char* fmt) {
+  size_t ret = 1;
+  for (; *fmt != '\0'; ++fmt) {
+    if (*fmt == '$')
+      ++ret;
+  }
+  return ret;
+}
+
+template <size_t N>
+struct FmtTable {
+  FmtSegment segments[N];
+  size_t literalLength;
+};
+
+// N has to be segmentCount(fmt).
+template <size_t N>
+constexpr FmtTable<N> parseFmt(const char* fmt) {
+  FmtTable<N> table{};
+  size_t n = 0;
+  const char* literal = fmt;
+  const char* it = fmt;
+  while (*it != '\0') {
+    if (*it == '$') {
+      auto placeholder = readPlaceholderWithSpec(it + 1);
+      if (placeholder.index == 0)
+        throw std::logic_error("Placeholders are numbered from 1");
+      table.segments[n++] = FmtSegment{
+        size_t(literal - fmt), size_t(it - literal), placeholder.index, placeholder.spec};
+      table.literalLength += it - literal;
+      it = literal = placeholder.next;
+    } else {
+      ++it;
+    }
+  }
+  table.segments[n] = FmtSegment{size_t(literal - fmt), size_t(it - literal), 0};
+  table.literalLength += it - literal;
+  return table;
+}
+
+// Room reserved for a field before it is rendered; exact for text.
+inline size_t textLengthHint(const TypeAndValue& tv) {
+  switch (tv.captured.kind) {
+    case CapturedValue::Kind::None: return tv.value.size();
+    case CapturedValue::Kind::Character: return 1;
+    case CapturedValue::Kind::StaticString: return strlen(tv.captured.s);
+    default: return 24;
+  }
+}
+
+inline size_t textLengthHint(const TypeAndValue& tv, const FmtSpec& spec) {
+  return std::max<size_t>(textLengthHint(tv), spec.width);
+}
+
 } // detail
 
+namespace detail {
+
+// No parsing, the segments were found by MakeFmt at compile time.
+inline void formatWithLayout(
+  const FmtLayout& layout, const LoggerMessage::TypeAndValueSequence& seq, std::string& str) {
+  const auto* first = layout.segments;
+  const auto* last = first + layout.count;
+
+  size_t length = layout.literalLength;
+  for (auto s = first; s != last; ++s) {
+    if (s->index != 0 && s->index < seq.size())
+      length += textLengthHint(seq[s->index], s->spec);
+  }
+  str.reserve(length);
+
+  for (auto s = first; s != last; ++s) {
+    str.append(layout.string + s->offset, s->length);
+    if (s->index != 0 && s->index < seq.size())
+      appendText(str, seq[s->index], s->spec);
+  }
+}
+
+// Format strings that did not come through MakeFmt are parsed on every message.
+inline void formatParsing(const LoggerMessage::TypeAndValueSequence& seq, std::string& str) {
+  const bool isStatic = seq[0].captured.kind == CapturedValue::Kind::StaticString;
+  const char* ch = isStatic ? seq[0].captured.s : seq[0].value.c_str();
+  const char* end = ch + (isStatic ? strlen(ch) : seq[0].value.size());
+
+  while (ch != end) {
+    if (*ch == '$') {
+      ++ch;
+      auto placeholder = readPlaceholderWithSpec(ch);
+      appendText(str, seq[placeholder.index], placeholder.spec);
+      ch = placeholder.next;
+    } else {
+      str += *ch++;
+    }
+  }
+}
+
+} // detail
+
+// Replaces a message starting with a format string by the single formatted text.
+inline void evaluateFmt(LoggerMessage& msg) {
+  auto& seq = msg.sequence;
+  if (seq.empty() || seq[0].type != tags::fmt())
+    return;
+
+  std::string str;
+  if (seq[0].captured.kind == CapturedValue::Kind::Format)
+    detail::formatWithLayout(*seq[0].captured.format, seq, str);
+  else
+    detail::formatParsing(seq, str);
+  seq.clear();
+  seq.emplace_back(TypeAndValue{tags::formatted(), std::move(str)});
+}
+
 class FmtEvaluatingBackend: public LoggerBackend {
 public:
   explicit FmtEvaluatingBackend(std::shared_ptr<LoggerBackend> toDecorate):
   decorated(toDecorate) {}
 
   void take(LoggerMessage&& msg) override {
-    auto& seq = msg.sequence;
-    if (seq[0].type == "yall::Fmt") {
-      const std::string& fmt = seq[0].value;
-
-      std::string str;
-
-      const char* ch = &fmt[0];
-      const char* end = ch + fmt.size();
-      while (ch != end) {
-        if (*ch == '$') {
-          ++ch;
-          auto indexAndEnd = ::yall::detail::readPlaceholder(ch);
-          str += seq[indexAndEnd.first].value;
-          ch = indexAndEnd.second;
-        } else {
-          str += *ch++;
-        }
-      }
-      seq.clear();
-      seq.emplace_back(TypeAndValue{"yall::Formatted", std::move(str)});
-    }
+    evaluateFmt(msg);
     decorated->take(std::move(msg));
   }
+
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    for (auto it = first; it != last; ++it) {
+      evaluateFmt(*it);
+    }
+    decorated->takeBatch(first, last);
+  }
 private:
   std::shared_ptr<LoggerBackend> decorated;
 };
@@ -157,6 +357,14 @@ private:
 
 #else
 
-#define MakeFmt(fmt_str) ::yall::detail::Fmt<::yall::detail::placeholderCount(fmt_str)>(fmt_str)
+// The format string is parsed and validated once, at compile time,
+// the resulting segment table is kept in static storage of the lambda.
+#define MakeFmt(fmt_str) ([]() { \
+    static constexpr auto table = \
+      ::yall::detail::parseFmt<::yall::detail::segmentCount(fmt_str)>(fmt_str); \
+    static constexpr ::yall::detail::FmtLayout layout{ \
+      fmt_str, table.segments, ::yall::detail::segmentCount(fmt_str), table.literalLength}; \
+    return ::yall::detail::Fmt<::yall::detail::placeholderCount(fmt_str)>(layout); \
+  }())
 
 #endif
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/capture.hpp"
+#include "yall/priority.hpp"
+#include "yall/timestamp.hpp"
+#include "yall/toString.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace yall {
+
+// Line layout compiled once from a pattern into a list of emit operations.
+//
+//   %d  date, YYYY-MM-DD          %i  thread id
+//   %t  time, HH:MM:SS.mmm        %p  priority
+//   %n  prefix (logger name)      %m  the message fields
+//   %%  a percent sign
+//
+// A width between '%' and the letter pads the field with spaces, on the left
+// by default, on the right with a '-' in front: "%8p" is "   debug",
+// "%-8p" is "debug   ".
+class Layout {
+public:
+  static const char* defaultPattern() {
+    return "%d %t <%i> %8p -%n- %m";
+  }
+
+  explicit Layout(
+    const std::string& pattern = defaultPattern(),
+    TimeStampFormatter aTimeFormatter = TimeStampFormatter::local()
+  ): timeFormatter(aTimeFormatter) {
+    compile(pattern);
+  }
+
+  void append(std::string& out, const LoggerMessage& msg) const {
+    char time[TimeStampFormatter::length];
+    if (needsTime)
+      timeFormatter.format(msg.meta.timeStamp, time);
+
+    for (const auto& op : ops) {
+      const size_t before = out.size();
+      switch (op.field) {
+        case Field::Literal:
+          out.append(literals, op.offset, op.length);
+          break;
+        case Field::Date:
+          out.append(time, 10);
+          break;
+        case Field::Time:
+          out.append(time + 11, TimeStampFormatter::length - 11);
+          break;
+        case Field::Thread:
+          appendThreadId(out, msg.meta.threadId);
+          break;
+        case Field::Priority:
+          if (msg.meta.hasPriority)
+            out += priorityName(msg.meta.priority);
+          break;
+        case Field::Prefix:
+          if (msg.meta.prefix)
+            out += *msg.meta.prefix;
+          break;
+        case Field::Message:
+          for (const auto& tv : msg.sequence) {
+            appendText(out, tv);
+          }
+          break;
+      }
+      pad(out, before, op);
+    }
+  }
+
+  // Room to reserve for a line, exact for literals and text fields.
+  size_t lengthHint(const LoggerMessage& msg) const {
+    size_t ret = fixedLength;
+    if (needsMessage) {
+      for (const auto& tv : msg.sequence) {
+        ret += tv.captured.kind == CapturedValue::Kind::None ? tv.value.size() : maxNumberLength;
+      }
+    }
+    return ret;
+  }
+
+private:
+  enum class Field : unsigned char {
+    Literal,
+    Date,
+    Time,
+    Thread,
+    Priority,
+    Prefix,
+    Message
+  };
+
+  struct Op {
+    Field field;
+    bool left;
+    unsigned width;
+    size_t offset;
+    size_t length;
+  };
+
+  void compile(const std::string& pattern) {
+    for (size_t i = 0; i < pattern.size(); ++i) {
+      if (pattern[i] != '%' || (i + 1 < pattern.size() && pattern[i + 1] == '%')) {
+        i += pattern[i] == '%';
+        addLiteral(pattern[i]);
+        continue;
+      }
+
+      Op op{Field::Literal, false, 0, 0, 0};
+      if (++i < pattern.size() && pattern[i] == '-') {
+        op.left = true;
+        ++i;
+      }
+      while (i < pattern.size() && '0' <= pattern[i] && pattern[i] <= '9') {
+        op.width = op.width * 10 + (pattern[i++] - '0');
+      }
+      if (i == pattern.size())
+        throw std::invalid_argument("Layout pattern ends inside a directive: " + pattern);
+
+      switch (pattern[i]) {
+        case 'd': op.field = Field::Date; fixedLength += 10; break;
+        case 't': op.field = Field::Time; fixedLength += 12; break;
+        case 'i': op.field = Field::Thread; fixedLength += 16; break;
+        case 'p': op.field = Field::Priority; fixedLength += 7; break;
+        case 'n': op.field = Field::Prefix; fixedLength += 16; break;
+        case 'm': op.field = Field::Message; needsMessage = true; break;
+        default:
+          throw std::invalid_argument(std::string("Unknown layout directive %") + pattern[i]);
+      }
+      needsTime = needsTime || op.field == Field::Date || op.field == Field::Time;
+      fixedLength += op.width;
+      ops.push_back(op);
+    }
+  }
+
+  void addLiteral(char c) {
+    if (ops.empty() || ops.back().field != Field::Literal)
+      ops.push_back(Op{Field::Literal, false, 0, literals.size(), 0});
+    literals += c;
+    ++ops.back().length;
+    ++fixedLength;
+  }
+
+  static void pad(std::string& out, size_t before, const Op& op) {
+    const size_t written = out.size() - before;
+    if (written >= op.width)
+      return;
+    if (op.left)
+      out.append(op.width - written, ' ');
+    else
+      out.insert(before, op.width - written, ' ');
+  }
+
+  TimeStampFormatter timeFormatter;
+  std::string literals;
+  std::vector<Op> ops;
+  size_t fixedLength = 0;
+  bool needsTime = false;
+  bool needsMessage = false;
+};
+
+// Replaces the fields of the message by the single line laid out.
+inline void applyLayout(const Layout& layout, LoggerMessage& msg) {
+  std::string line;
+  line.reserve(layout.lengthHint(msg));
+  layout.append(line, msg);
+
+  msg.sequence.clear();
+  msg.sequence.emplace_back(TypeAndValue{tags::formatted(), std::move(line)});
+}
+
+} // namespace yall
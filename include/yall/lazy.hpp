@@ -0,0 +1,44 @@
+#pragma once
+
+#include "yall/toString.hpp"
+
+#include <type_traits>
+#include <utility>
+
+namespace yall {
+
+// An argument produced by a callable, which the logger runs only when the
+// message is gathered, i.e. after the priority given up front passed:
+//
+//   log.log(Priority::Debug, "cache ", lazy([&] { return dump(cache); }));
+//
+// The result is logged as if it had been passed directly, so it may be text,
+// a number, a metadata type or anything else with a toString. In the stream
+// interface a priority streamed after the lazy argument comes too late to spare it.
+template <typename F>
+class Lazy {
+public:
+  using Result = decltype(std::declval<const F&>()());
+  static_assert(!std::is_void<Result>::value, "yall::lazy needs a callable returning a value");
+
+  explicit Lazy(F f) : producer(std::move(f)) {}
+
+  Result operator()() const {
+    return producer();
+  }
+
+private:
+  F producer;
+};
+
+template <typename F>
+Lazy<typename std::decay<F>::type> lazy(F&& f) {
+  return Lazy<typename std::decay<F>::type>(std::forward<F>(f));
+}
+
+template <typename F>
+std::string toString(const Lazy<F>& l) {
+  return toString(l());
+}
+
+} // namespace yall
@@ -3,90 +3,326 @@
 #include "yall/types.hpp"
 #include "yall/fmt.hpp"
 #include "yall/toString.hpp"
+#include "yall/priority.hpp"
+#include "yall/pool.hpp"
+#include "yall/lazy.hpp"
 
+#include <atomic>
 #include <memory>
 
+// Calls below this priority made through YALL_LOG/YALL_STREAM or Logger::log<P>
+// are removed at compile time.
+#ifndef YALL_MINIMUM_PRIORITY
+#define YALL_MINIMUM_PRIORITY ::yall::Priority::Debug
+#endif
+
 namespace yall {
 
+// Metadata without a dedicated slot goes to the user map as text.
+template <typename T>
+void attachMeta(MessageMeta& meta, const T& t) {
+  meta.user.set(typeTag(t), toString(t));
+}
+
 namespace {
 
 template <typename T>
 typename std::enable_if <isLogMetaData<T>::value, LoggerMessage&>::type
 extend(LoggerMessage& msg, const T& t) {
-  msg.meta[typeString(t)] = toString(t);
+  attachMeta(msg.meta, t);
+  return msg;
 }
 
 template <typename T>
 typename  std::enable_if <!isLogMetaData<T>::value, LoggerMessage&>::type
 extend(LoggerMessage& msg, const T& t) {
-  msg.sequence.emplace_back(TypeAndValue{typeString(t), toString(t)});
+  msg.sequence.emplace_back(TypeAndValue{typeTag(t), toString(t)});
+  return msg;
+}
+
+// Format strings are static in either capture mode, so the segment table made by MakeFmt travels along.
+// Captured eagerly, the field carries the format string as text too, for backends reading value only.
+template <size_t C>
+LoggerMessage& extend(LoggerMessage& msg, const ::yall::detail::Fmt<C>& fmt) {
+  msg.sequence.emplace_back(TypeAndValue{tags::fmt(), fmt.string});
+  capture(msg.sequence.back(), fmt);
+  return msg;
+}
+
+inline LoggerMessage& extend(LoggerMessage& msg, std::string&& str) {
+  msg.sequence.emplace_back(TypeAndValue{typeTag(str), std::move(str)});
+  return msg;
+}
+
+template <typename T>
+typename std::enable_if <isLogMetaData<T>::value, LoggerMessage&>::type
+extendDeferred(LoggerMessage& msg, const T& t) {
+  return extend(msg, t);
+}
+
+template <typename T>
+typename  std::enable_if <!isLogMetaData<T>::value, LoggerMessage&>::type
+extendDeferred(LoggerMessage& msg, const T& t) {
+  msg.sequence.emplace_back(TypeAndValue{typeTag(t), std::string()});
+  capture(msg.sequence.back(), t);
+  return msg;
+}
+
+inline LoggerMessage& extendDeferred(LoggerMessage& msg, std::string&& str) {
+  return extend(msg, std::move(str));
+}
+
+// The only place lazy arguments run, their result is added like a direct argument.
+template <typename F>
+LoggerMessage& extend(LoggerMessage& msg, const Lazy<F>& l) {
+  return extend(msg, l());
+}
+
+template <typename F>
+LoggerMessage& extendDeferred(LoggerMessage& msg, const Lazy<F>& l) {
+  return extendDeferred(msg, l());
+}
+
+template <typename T>
+using Decayed = typename std::decay<T>::type;
+
+template <typename ...Args>
+struct startsWithFmt : std::false_type {};
+
+template <typename First, typename ...Rest>
+struct startsWithFmt<First, Rest...> : std::is_base_of<::yall::detail::FmtBase, Decayed<First>> {};
+
+template <typename First>
+constexpr bool isPlainFirst() {
+  return !startsWithFmt<First>::value && !std::is_same<Decayed<First>, Priority>::value;
+}
+
+template <typename T>
+constexpr bool hasNativeCapture() {
+  return (isNumberType<T>() && !std::is_same<T, long double>::value) || std::is_same<T, char>::value;
+}
+
+template <typename T>
+typename std::enable_if<!hasNativeCapture<T>()>::type
+keepNative(TypeAndValue&, const T&) {}
+
+template <typename T>
+typename std::enable_if<hasNativeCapture<T>()>::type
+keepNative(TypeAndValue& tv, const T& t) {
+  capture(tv, t);
+}
+
+template <typename T>
+struct isLazy : std::false_type {};
+
+template <typename F>
+struct isLazy<Lazy<F>> : std::true_type {};
+
+// Eager arguments of a format string: numbers and characters keep their native
+// form next to the text, so that placeholder specs can still apply radix and precision.
+template <typename T, typename = typename std::enable_if<!isLazy<Decayed<T>>::value>::type>
+LoggerMessage& extendFmtArgument(LoggerMessage& msg, T&& t) {
+  const size_t fields = msg.sequence.size();
+  extend(msg, std::forward<T>(t));
+  // Metadata adds no field. Numbers and characters are never moved from.
+  if (msg.sequence.size() != fields)
+    keepNative(msg.sequence.back(), t);
+  return msg;
+}
+
+template <typename F>
+LoggerMessage& extendFmtArgument(LoggerMessage& msg, const Lazy<F>& l) {
+  return extendFmtArgument(msg, l());
 }
 
 }
 
+// Eager converts arguments to text on the calling thread.
+// Deferred keeps numbers, characters and format strings in native form,
+// the text is produced by the backends (see capture.hpp).
+enum class Capture {
+  Eager,
+  Deferred
+};
+
+// Owner of a threshold that more than the loggers sharing it depend on, e.g. a
+// LoggerNode whose descendants follow it. Changes made through a logger go to it.
+class ThresholdOwner {
+public:
+  virtual void setThreshold(Priority p) = 0;
+
+protected:
+  ~ThresholdOwner() = default;
+};
+
 class Logger {
   struct Gatherer {
-    Gatherer(Logger& parent) : logger(parent) {}
+    Gatherer(Logger& parent) : msg(MessagePool::acquire()), logger(parent), enabled(true) {}
+    Gatherer(Logger& parent, Priority priority)
+      : msg(MessagePool::acquire()), logger(parent), enabled(parent.enabled(priority)) {
+      if (enabled)
+        logger.append(msg, priority);
+    }
+    Gatherer(Gatherer&& other) : msg(std::move(other.msg)), logger(other.logger), enabled(other.enabled) {
+      other.enabled = false;
+    }
+    Gatherer(const Gatherer&) = delete;
     ~Gatherer() {
-      logger.callBackend(std::move(msg));
+      if (enabled)
+        logger.callBackend(std::move(msg));
     }
 
     template <typename T>
     Gatherer& operator<<(const T& t) {
-      extend(msg, t);
+      if (enabled)
+        logger.append(msg, t);
+      return *this;
+    }
+
+    Gatherer& operator<<(std::string&& str) {
+      if (enabled)
+        logger.append(msg, std::move(str));
+      return *this;
+    }
+
+    // Priority streamed late can still drop the message, but only after the earlier fields were gathered.
+    // A message already dropped stays dropped, its earlier fields are missing.
+    Gatherer& operator<<(Priority priority) {
+      enabled = enabled && logger.enabled(priority);
+      if (enabled)
+        logger.append(msg, priority);
       return *this;
     }
 
     template <size_t C>
-    constexpr Gatherer& operator<<(const ::yall::detail::Fmt<C>&) {
+    Gatherer& operator<<(const ::yall::detail::Fmt<C>&) {
       static_assert(C > 0, "Do not use Fmt in stream interface");
+      return *this;
     }
 
     LoggerMessage msg;
     Logger& logger;
+    bool enabled;
   };
   friend Gatherer;
 public:
-  explicit Logger(std::shared_ptr<LoggerBackend> aBackend) : backend(aBackend) {}
+  explicit Logger(std::shared_ptr<LoggerBackend> aBackend, Capture aCapture = Capture::Eager)
+    : backend(aBackend), captureMode(aCapture),
+      threshold(std::make_shared<std::atomic<Priority>>(Priority::Debug)) {}
   Logger() = delete;
 
+  // Copies of a logger share the threshold, like they share the backend.
+  void setThreshold(Priority p) {
+    if (thresholdOwner)
+      thresholdOwner->setThreshold(p);
+    else
+      threshold->store(p, std::memory_order_relaxed);
+  }
+
+  Priority getThreshold() const {
+    return threshold->load(std::memory_order_relaxed);
+  }
+
+  bool enabled(Priority p) const {
+    return p >= YALL_MINIMUM_PRIORITY && p >= threshold->load(std::memory_order_relaxed);
+  }
+
   Gatherer operator()() {
     return Gatherer(*this);
   }
 
-  template <typename ...Args, typename First>
-  void operator()(const First& first, Args... args) const {
-    log(first, args...);
+  Gatherer operator()(Priority priority) {
+    return Gatherer(*this, priority);
   }
 
-  template <typename ...Args, typename First>
-  void log(const First& first, Args... args) const {
-    LoggerMessage msg;
-    gather(msg, first, args...);
+  // Arguments are forwarded down to extend, rvalue strings end up moved into the message.
+  template <typename First, typename ...Args,
+            typename = typename std::enable_if<isPlainFirst<First>()>::type>
+  void operator()(First&& first, Args&&... args) const {
+    log(std::forward<First>(first), std::forward<Args>(args)...);
+  }
+
+  template <typename First, typename ...Args,
+            typename = typename std::enable_if<isPlainFirst<First>()>::type>
+  void log(First&& first, Args&&... args) const {
+    LoggerMessage msg = MessagePool::acquire();
+    gather(msg, std::forward<First>(first), std::forward<Args>(args)...);
     callBackend(std::move(msg));
   }
 
   template <size_t C, typename ...Args>
-  void operator()(const ::yall::detail::Fmt<C>& fmt, Args... args) const {
-    log(fmt, args...);
+  void operator()(const ::yall::detail::Fmt<C>& fmt, Args&&... args) const {
+    log(fmt, std::forward<Args>(args)...);
   }
 
   template <size_t C, typename ...Args>
-  void log(const ::yall::detail::Fmt<C>& fmt, Args... args) const {
+  void log(const ::yall::detail::Fmt<C>& fmt, Args&&... args) const {
     static_assert(C == sizeof...(args),
                   "Number of arguments and substitution tokens does not match.");
-    LoggerMessage msg;
-    extend(msg, fmt);
-    gather(msg, args...);
+    LoggerMessage msg = MessagePool::acquire();
+    append(msg, fmt);
+    gatherFmtArguments(msg, std::forward<Args>(args)...);
+    callBackend(std::move(msg));
+  }
+
+  // Priority given first is checked before anything is gathered.
+  template <typename ...Args,
+            typename = typename std::enable_if<!startsWithFmt<Args...>::value>::type>
+  void log(Priority priority, Args&&... args) const {
+    if (!enabled(priority)) return;
+    LoggerMessage msg = MessagePool::acquire();
+    append(msg, priority);
+    gather(msg, std::forward<Args>(args)...);
+    callBackend(std::move(msg));
+  }
+
+  template <size_t C, typename ...Args>
+  void log(Priority priority, const ::yall::detail::Fmt<C>& fmt, Args&&... args) const {
+    static_assert(C == sizeof...(args),
+                  "Number of arguments and substitution tokens does not match.");
+    if (!enabled(priority)) return;
+    LoggerMessage msg = MessagePool::acquire();
+    append(msg, priority);
+    append(msg, fmt);
+    gatherFmtArguments(msg, std::forward<Args>(args)...);
     callBackend(std::move(msg));
   }
+
+  template <typename First, typename ...Args,
+            typename = typename std::enable_if<!startsWithFmt<First>::value>::type>
+  void operator()(Priority priority, First&& first, Args&&... args) const {
+    log(priority, std::forward<First>(first), std::forward<Args>(args)...);
+  }
+
+  template <size_t C, typename ...Args>
+  void operator()(Priority priority, const ::yall::detail::Fmt<C>& fmt, Args&&... args) const {
+    log(priority, fmt, std::forward<Args>(args)...);
+  }
+
+  template <Priority P, typename ...Args>
+  void log(Args&&... args) const {
+    if (!enabled(P)) return;
+    log(P, std::forward<Args>(args)...);
+  }
 private:
 
+  template <typename T>
+  void append(LoggerMessage& msg, T&& t) const {
+    if (captureMode == Capture::Deferred)
+      extendDeferred(msg, std::forward<T>(t));
+    else
+      extend(msg, std::forward<T>(t));
+  }
+
+  // Stamps the message in place and moves it on, the chain never copies it.
+  // Whatever storage the chain did not take over goes back to the pool.
   inline void callBackend(LoggerMessage&& msg) const {
-    LoggerMessage data(msg);
-    data.meta["yall::TimeStamp"] = toString(std::chrono::system_clock::now());
-    data.meta["yall::ThreadId"] = toString(std::this_thread::get_id());
-    backend->take(std::move(data));
+    msg.meta.timeStamp = std::chrono::system_clock::now();
+    msg.meta.threadId = std::this_thread::get_id();
+    if (prefix)
+      msg.meta.prefix = prefix;
+    backend->take(std::move(msg));
+    MessagePool::release(std::move(msg));
   }
 
   template <typename ...Args>
@@ -95,14 +331,45 @@ private:
   }
 
   template <typename Head, typename ...Tail>
-  LoggerMessage& gather(LoggerMessage& msg, const Head& head, Tail... tail) const {
-    static_assert(!std::is_base_of<::yall::detail::FmtBase, Head>::value,
+  LoggerMessage& gather(LoggerMessage& msg, Head&& head, Tail&&... tail) const {
+    static_assert(!startsWithFmt<Head>::value,
+                  "Format can be only the very first argument");
+    append(msg, std::forward<Head>(head));
+    return gather(msg, std::forward<Tail>(tail)...);
+  }
+
+  LoggerMessage& gatherFmtArguments(LoggerMessage& msg) const {
+    return msg;
+  }
+
+  template <typename Head, typename ...Tail>
+  LoggerMessage& gatherFmtArguments(LoggerMessage& msg, Head&& head, Tail&&... tail) const {
+    static_assert(!startsWithFmt<Head>::value,
                   "Format can be only the very first argument");
-    extend(msg, head);
-    return gather<Tail...>(msg, tail...);
+    if (captureMode == Capture::Deferred)
+      extendDeferred(msg, std::forward<Head>(head));
+    else
+      extendFmtArgument(msg, std::forward<Head>(head));
+    return gatherFmtArguments(msg, std::forward<Tail>(tail)...);
   }
 
   std::shared_ptr<LoggerBackend> backend;
+  Capture captureMode;
+
+protected:
+  // Shared by the copies of a logger, see PrefixedLogger for one owned by a LoggerNode.
+  std::shared_ptr<std::atomic<Priority>> threshold;
+  // Changes the threshold when set, it must outlive the logger and its copies.
+  ThresholdOwner* thresholdOwner = nullptr;
+  // Attached to every message when set; interned, never freed.
+  const std::string* prefix = nullptr;
 };
 
 }
+
+// Neither the call nor its arguments are evaluated when the priority is disabled.
+#define YALL_LOG(logger, priority, ...) \
+  if (!(logger).enabled(priority)) {} else (logger).log((priority), __VA_ARGS__)
+
+#define YALL_STREAM(logger, priority) \
+  if (!(logger).enabled(priority)) {} else (logger)(priority)
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/queue.hpp"
+#include "yall/pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace yall {
+
+// Asynchronous backend where every producing thread has a buffer of its own.
+//
+// A thread registers on its first take() and gets a single-producer ring, so
+// producers share no queue positions and no lock. Its buffer is unregistered
+// once the thread has exited and everything it logged was delivered.
+//
+// A background thread merges the per-thread streams in timestamp order and
+// passes them to the decorated backend in batches. A message is delivered
+// once every registered thread has an older one waiting, or once it has been
+// waiting for the reordering window, or once its thread's buffer is full.
+// Messages of a thread that fell behind by more than the window may therefore
+// come after younger messages of others; the window is what an idle thread
+// can add to the latency of the rest.
+class MergingBackend : public LoggerBackend {
+public:
+  enum : size_t {
+    defaultLaneCapacity = 256,
+    maxBatch = 64
+  };
+
+  explicit MergingBackend(std::shared_ptr<LoggerBackend> toDecorate,
+                          std::chrono::microseconds aWindow = std::chrono::milliseconds(2),
+                          size_t aLaneCapacity = defaultLaneCapacity)
+    : decorated(std::move(toDecorate)), window(aWindow), laneCapacity(aLaneCapacity),
+      id(nextId()), lanesChanged(false), flushing(0), waiting(false), stopping(false),
+      consumer(&MergingBackend::run, this) {}
+
+  MergingBackend(const MergingBackend&) = delete;
+  MergingBackend& operator=(const MergingBackend&) = delete;
+
+  // Delivers everything taken so far. No thread may call take() meanwhile.
+  ~MergingBackend() {
+    stopping.store(true);
+    wake();
+    consumer.join();
+    std::lock_guard<std::mutex> lock(lanesMutex);
+    for (auto& lane : lanes) {
+      lane->abandoned.store(true, std::memory_order_release);
+    }
+  }
+
+  // Spins while the thread's buffer is full.
+  void take(LoggerMessage&& msg) override {
+    auto& ring = ownLane().ring;
+    while (!ring.tryPush(std::move(msg))) {
+      wake();
+      std::this_thread::yield();
+    }
+    notify();
+  }
+
+  // Blocks until everything taken before the call reached the decorated
+  // backend. Messages are not held back for the window meanwhile.
+  void flush() {
+    std::vector<std::pair<std::shared_ptr<Lane>, size_t>> targets;
+    {
+      std::lock_guard<std::mutex> lock(lanesMutex);
+      for (auto& lane : lanes) {
+        targets.emplace_back(lane, lane->ring.pushed());
+      }
+    }
+    flushing.fetch_add(1);
+    for (auto& target : targets) {
+      while (target.first->delivered.load(std::memory_order_acquire) < target.second) {
+        wake();
+        std::this_thread::yield();
+      }
+    }
+    flushing.fetch_sub(1);
+  }
+
+  // Threads currently registered.
+  size_t producers() const {
+    std::lock_guard<std::mutex> lock(lanesMutex);
+    return lanes.size();
+  }
+
+private:
+  struct Lane {
+    explicit Lane(size_t capacity) : ring(capacity), delivered(0), closed(false), abandoned(false) {}
+
+    detail::SpscRing<LoggerMessage> ring;
+    std::atomic<size_t> delivered;
+    std::atomic<bool> closed;     // the producing thread exited
+    std::atomic<bool> abandoned;  // the backend is gone
+  };
+
+  struct Registration {
+    uint64_t backend;
+    std::shared_ptr<Lane> lane;
+  };
+
+  // The lanes of one thread, closed when the thread exits.
+  struct ThreadLanes {
+    ~ThreadLanes() {
+      for (auto& r : registrations) {
+        r.lane->closed.store(true, std::memory_order_release);
+      }
+    }
+    std::vector<Registration> registrations;
+  };
+
+  // Backends are told apart by id, an address may be reused by the next one.
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> last(0);
+    return ++last;
+  }
+
+  static ThreadLanes& threadLanes() {
+    thread_local ThreadLanes lanes;
+    return lanes;
+  }
+
+  Lane& ownLane() {
+    auto& registrations = threadLanes().registrations;
+    for (auto& r : registrations) {
+      if (r.backend == id)
+        return *r.lane;
+    }
+    return registerThread(registrations);
+  }
+
+  Lane& registerThread(std::vector<Registration>& registrations) {
+    registrations.erase(
+      std::remove_if(registrations.begin(), registrations.end(), [](const Registration& r) {
+        return r.lane->abandoned.load(std::memory_order_acquire);
+      }),
+      registrations.end());
+
+    auto lane = std::make_shared<Lane>(laneCapacity);
+    {
+      std::lock_guard<std::mutex> lock(lanesMutex);
+      lanes.push_back(lane);
+      lanesChanged.store(true, std::memory_order_release);
+    }
+    registrations.push_back(Registration{id, lane});
+    return *lane;
+  }
+
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed))
+      wake();
+  }
+
+  void wake() {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    wakeUp.notify_one();
+  }
+
+  void run() {
+    std::vector<std::shared_ptr<Lane>> active;
+    std::vector<LoggerMessage> batch;
+    std::vector<Lane*> origins;
+    batch.reserve(maxBatch);
+    origins.reserve(maxBatch);
+
+    for (;;) {
+      if (lanesChanged.exchange(false, std::memory_order_acq_rel)) {
+        std::lock_guard<std::mutex> lock(lanesMutex);
+        active = lanes;
+      }
+      const bool stop = stopping.load();
+      const bool drain = stop || flushing.load() != 0;
+
+      TimeStamp heldBack = TimeStamp::max();
+      bool finished = false;
+      merge(active, drain, batch, origins, heldBack, finished);
+
+      if (!batch.empty()) {
+        deliver(batch, origins);
+        continue;
+      }
+      if (finished)
+        prune(active);
+      if (stop && std::all_of(active.begin(), active.end(),
+                              [](const std::shared_ptr<Lane>& l) { return l->ring.empty(); }))
+        return;
+
+      // Sleep until woken by a producer, or until the oldest message held back may go.
+      auto timeout = std::chrono::milliseconds(10);
+      if (heldBack != TimeStamp::max()) {
+        auto due = std::chrono::duration_cast<std::chrono::milliseconds>(
+          heldBack + window - std::chrono::system_clock::now()) + std::chrono::milliseconds(1);
+        timeout = std::max(std::chrono::milliseconds(0), std::min(timeout, due));
+      }
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      waiting.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!stopping.load() && flushing.load() == 0 && !lanesChanged.load() && !readyToMerge(active))
+        wakeUp.wait_for(lock, timeout);
+      waiting.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  // Moves up to maxBatch messages in timestamp order into the batch. heldBack
+  // is set to the oldest message kept for the window, finished tells whether
+  // some lane was closed and empty.
+  void merge(std::vector<std::shared_ptr<Lane>>& active, bool drain,
+             std::vector<LoggerMessage>& batch, std::vector<Lane*>& origins,
+             TimeStamp& heldBack, bool& finished) {
+    const TimeStamp now = std::chrono::system_clock::now();
+    while (batch.size() < maxBatch) {
+      Lane* oldest = nullptr;
+      LoggerMessage* candidate = nullptr;
+      bool waitingForSome = false;
+      bool pressing = false;
+      for (auto& lane : active) {
+        // Closed is read first, so that a closed lane found empty stays empty.
+        const bool closed = lane->closed.load(std::memory_order_acquire);
+        LoggerMessage* front = lane->ring.front();
+        if (!front) {
+          if (closed)
+            finished = true;
+          else
+            waitingForSome = true;
+          continue;
+        }
+        pressing = pressing || lane->ring.full();
+        if (!candidate || front->meta.timeStamp < candidate->meta.timeStamp) {
+          oldest = lane.get();
+          candidate = front;
+        }
+      }
+      if (!candidate)
+        return;
+      if (waitingForSome && !drain && !pressing && candidate->meta.timeStamp + window > now) {
+        heldBack = candidate->meta.timeStamp;
+        return;
+      }
+      batch.push_back(std::move(*candidate));
+      oldest->ring.pop();
+      origins.push_back(oldest);
+    }
+  }
+
+  bool readyToMerge(const std::vector<std::shared_ptr<Lane>>& active) const {
+    return std::all_of(active.begin(), active.end(), [](const std::shared_ptr<Lane>& l) {
+      return !l->ring.empty() || l->closed.load(std::memory_order_acquire);
+    }) && std::any_of(active.begin(), active.end(), [](const std::shared_ptr<Lane>& l) {
+      return !l->ring.empty();
+    });
+  }
+
+  void deliver(std::vector<LoggerMessage>& batch, std::vector<Lane*>& origins) {
+    try {
+      decorated->takeBatch(batch.data(), batch.data() + batch.size());
+    } catch (...) {
+      // Nobody to report to on this thread; losing a batch beats terminating.
+    }
+    for (auto& msg : batch) {
+      MessagePool::release(std::move(msg));
+    }
+    for (auto lane : origins) {
+      lane->delivered.fetch_add(1, std::memory_order_release);
+    }
+    batch.clear();
+    origins.clear();
+  }
+
+  // Unregisters the lanes of exited threads, all their messages were delivered.
+  void prune(std::vector<std::shared_ptr<Lane>>& active) {
+    auto done = [](const std::shared_ptr<Lane>& l) {
+      return l->closed.load(std::memory_order_acquire) && l->ring.empty();
+    };
+    std::lock_guard<std::mutex> lock(lanesMutex);
+    lanes.erase(std::remove_if(lanes.begin(), lanes.end(), done), lanes.end());
+    active = lanes;
+  }
+
+  std::shared_ptr<LoggerBackend> decorated;
+  const std::chrono::microseconds window;
+  const size_t laneCapacity;
+  const uint64_t id;
+
+  mutable std::mutex lanesMutex;
+  std::vector<std::shared_ptr<Lane>> lanes;
+  std::atomic<bool> lanesChanged;
+  std::atomic<size_t> flushing;
+
+  std::atomic<bool> waiting;
+  std::atomic<bool> stopping;
+  std::mutex wakeMutex;
+  std::condition_variable wakeUp;
+  std::thread consumer;
+};
+
+} // namespace yall
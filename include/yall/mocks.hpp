@@ -14,12 +14,11 @@ public:
 namespace yall {
   inline void PrintTo(const LoggerMessage& msg, ::std::ostream* os) {
     *os << "LoggerMessage{meta:{";
-    for (const auto& kv : msg.meta) {
-      *os << "{" << kv.first << ", " << kv.second << "}";
-    }
+    writeMeta(*os, msg.meta);
     *os << "}, sequence:{";
     for (const auto& kv : msg.sequence) {
-      *os << "{" << kv.type << ", " << kv.value << "}";
+      *os << "{" << kv.type << ", ";
+      writeText(*os, kv) << "}";
     }
     *os << "}}";
   }
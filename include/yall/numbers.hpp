@@ -0,0 +1,444 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// Conversions of numbers to text into a caller provided buffer of at least
+// maxNumberLength characters. They return the end of the written text, do not
+// allocate, do not look at the locale and do not terminate with '\0'.
+
+namespace yall {
+
+constexpr size_t maxNumberLength = 32;
+
+namespace detail {
+
+inline const char* digitPairs() {
+  static const char pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  return pairs;
+}
+
+inline unsigned decimalLength(uint64_t v) {
+  unsigned n = 1;
+  for (;;) {
+    if (v < 10) return n;
+    if (v < 100) return n + 1;
+    if (v < 1000) return n + 2;
+    if (v < 10000) return n + 3;
+    v /= 10000;
+    n += 4;
+  }
+}
+
+// Grisu2 by F. Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+// with Integers", in the variant with the digit generation and boundaries of
+// nlohmann/json. The result always reads back to the same value and is
+// the shortest such representation in the vast majority of cases.
+namespace grisu {
+
+struct DiyFp {
+  uint64_t f;
+  int e;
+
+  static DiyFp sub(DiyFp x, DiyFp y) {
+    return DiyFp{x.f - y.f, x.e};
+  }
+
+  // Upper half of the 128 bit product, rounded.
+  static DiyFp mul(DiyFp x, DiyFp y) {
+    const uint64_t uLo = x.f & 0xFFFFFFFFu;
+    const uint64_t uHi = x.f >> 32;
+    const uint64_t vLo = y.f & 0xFFFFFFFFu;
+    const uint64_t vHi = y.f >> 32;
+
+    const uint64_t p0 = uLo * vLo;
+    const uint64_t p1 = uLo * vHi;
+    const uint64_t p2 = uHi * vLo;
+    const uint64_t p3 = uHi * vHi;
+
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu);
+    q += uint64_t(1) << 31;
+
+    return DiyFp{p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), x.e + y.e + 64};
+  }
+
+  static DiyFp normalize(DiyFp x) {
+    while ((x.f >> 63) == 0) {
+      x.f <<= 1;
+      --x.e;
+    }
+    return x;
+  }
+
+  static DiyFp normalizeTo(DiyFp x, int e) {
+    return DiyFp{x.f << (x.e - e), e};
+  }
+};
+
+struct Boundaries {
+  DiyFp w;
+  DiyFp minus;
+  DiyFp plus;
+};
+
+// The value and the halfway points to its neighbours, for a finite positive value.
+template <typename Float>
+Boundaries computeBoundaries(Float value) {
+  constexpr int precision = std::numeric_limits<Float>::digits;
+  constexpr int bias = std::numeric_limits<Float>::max_exponent - 1 + (precision - 1);
+  constexpr int minExponent = 1 - bias;
+  constexpr uint64_t hiddenBit = uint64_t(1) << (precision - 1);
+
+  using Bits = typename std::conditional<precision == 24, uint32_t, uint64_t>::type;
+  Bits bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint64_t exponentBits = bits >> (precision - 1);
+  const uint64_t fraction = bits & (hiddenBit - 1);
+
+  const DiyFp v = exponentBits == 0
+    ? DiyFp{fraction, minExponent}
+    : DiyFp{fraction + hiddenBit, int(exponentBits) - bias};
+
+  const bool lowerIsCloser = fraction == 0 && exponentBits > 1;
+  const DiyFp mPlus{2 * v.f + 1, v.e - 1};
+  const DiyFp mMinus = lowerIsCloser
+    ? DiyFp{4 * v.f - 1, v.e - 2}
+    : DiyFp{2 * v.f - 1, v.e - 1};
+
+  const DiyFp wPlus = DiyFp::normalize(mPlus);
+  return Boundaries{DiyFp::normalize(v), DiyFp::normalizeTo(mMinus, wPlus.e), wPlus};
+}
+
+struct CachedPower {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+// Normalized 10^k for k = -300, -292, ..., 324.
+inline CachedPower cachedPowerFor(int e) {
+  constexpr int alpha = -60;
+  constexpr int minDecimalExponent = -300;
+  constexpr int decimalStep = 8;
+  static const CachedPower powers[] = {
+    {0xAB70FE17C79AC6CA, -1060, -300},
+    {0xFF77B1FCBEBCDC4F, -1034, -292},
+    {0xBE5691EF416BD60C, -1007, -284},
+    {0x8DD01FAD907FFC3C,  -980, -276},
+    {0xD3515C2831559A83,  -954, -268},
+    {0x9D71AC8FADA6C9B5,  -927, -260},
+    {0xEA9C227723EE8BCB,  -901, -252},
+    {0xAECC49914078536D,  -874, -244},
+    {0x823C12795DB6CE57,  -847, -236},
+    {0xC21094364DFB5637,  -821, -228},
+    {0x9096EA6F3848984F,  -794, -220},
+    {0xD77485CB25823AC7,  -768, -212},
+    {0xA086CFCD97BF97F4,  -741, -204},
+    {0xEF340A98172AACE5,  -715, -196},
+    {0xB23867FB2A35B28E,  -688, -188},
+    {0x84C8D4DFD2C63F3B,  -661, -180},
+    {0xC5DD44271AD3CDBA,  -635, -172},
+    {0x936B9FCEBB25C996,  -608, -164},
+    {0xDBAC6C247D62A584,  -582, -156},
+    {0xA3AB66580D5FDAF6,  -555, -148},
+    {0xF3E2F893DEC3F126,  -529, -140},
+    {0xB5B5ADA8AAFF80B8,  -502, -132},
+    {0x87625F056C7C4A8B,  -475, -124},
+    {0xC9BCFF6034C13053,  -449, -116},
+    {0x964E858C91BA2655,  -422, -108},
+    {0xDFF9772470297EBD,  -396, -100},
+    {0xA6DFBD9FB8E5B88F,  -369,  -92},
+    {0xF8A95FCF88747D94,  -343,  -84},
+    {0xB94470938FA89BCF,  -316,  -76},
+    {0x8A08F0F8BF0F156B,  -289,  -68},
+    {0xCDB02555653131B6,  -263,  -60},
+    {0x993FE2C6D07B7FAC,  -236,  -52},
+    {0xE45C10C42A2B3B06,  -210,  -44},
+    {0xAA242499697392D3,  -183,  -36},
+    {0xFD87B5F28300CA0E,  -157,  -28},
+    {0xBCE5086492111AEB,  -130,  -20},
+    {0x8CBCCC096F5088CC,  -103,  -12},
+    {0xD1B71758E219652C,   -77,   -4},
+    {0x9C40000000000000,   -50,    4},
+    {0xE8D4A51000000000,   -24,   12},
+    {0xAD78EBC5AC620000,     3,   20},
+    {0x813F3978F8940984,    30,   28},
+    {0xC097CE7BC90715B3,    56,   36},
+    {0x8F7E32CE7BEA5C70,    83,   44},
+    {0xD5D238A4ABE98068,   109,   52},
+    {0x9F4F2726179A2245,   136,   60},
+    {0xED63A231D4C4FB27,   162,   68},
+    {0xB0DE65388CC8ADA8,   189,   76},
+    {0x83C7088E1AAB65DB,   216,   84},
+    {0xC45D1DF942711D9A,   242,   92},
+    {0x924D692CA61BE758,   269,  100},
+    {0xDA01EE641A708DEA,   295,  108},
+    {0xA26DA3999AEF774A,   322,  116},
+    {0xF209787BB47D6B85,   348,  124},
+    {0xB454E4A179DD1877,   375,  132},
+    {0x865B86925B9BC5C2,   402,  140},
+    {0xC83553C5C8965D3D,   428,  148},
+    {0x952AB45CFA97A0B3,   455,  156},
+    {0xDE469FBD99A05FE3,   481,  164},
+    {0xA59BC234DB398C25,   508,  172},
+    {0xF6C69A72A3989F5C,   534,  180},
+    {0xB7DCBF5354E9BECE,   561,  188},
+    {0x88FCF317F22241E2,   588,  196},
+    {0xCC20CE9BD35C78A5,   614,  204},
+    {0x98165AF37B2153DF,   641,  212},
+    {0xE2A0B5DC971F303A,   667,  220},
+    {0xA8D9D1535CE3B396,   694,  228},
+    {0xFB9B7CD9A4A7443C,   720,  236},
+    {0xBB764C4CA7A44410,   747,  244},
+    {0x8BAB8EEFB6409C1A,   774,  252},
+    {0xD01FEF10A657842C,   800,  260},
+    {0x9B10A4E5E9913129,   827,  268},
+    {0xE7109BFBA19C0C9D,   853,  276},
+    {0xAC2820D9623BF429,   880,  284},
+    {0x80444B5E7AA7CF85,   907,  292},
+    {0xBF21E44003ACDD2D,   933,  300},
+    {0x8E679C2F5E44FF8F,   960,  308},
+    {0xD433179D9C8CB841,   986,  316},
+    {0x9E19DB92B4E31BA9,  1013,  324},
+  };
+
+  const int f = alpha - e - 1;
+  const int k = (f * 78913) / (1 << 18) + (f > 0);
+  const int index = (-minDecimalExponent + k + (decimalStep - 1)) / decimalStep;
+  return powers[index];
+}
+
+inline int largestPow10(uint32_t n, uint32_t& pow10) {
+  if (n >= 1000000000) { pow10 = 1000000000; return 10; }
+  if (n >= 100000000) { pow10 = 100000000; return 9; }
+  if (n >= 10000000) { pow10 = 10000000; return 8; }
+  if (n >= 1000000) { pow10 = 1000000; return 7; }
+  if (n >= 100000) { pow10 = 100000; return 6; }
+  if (n >= 10000) { pow10 = 10000; return 5; }
+  if (n >= 1000) { pow10 = 1000; return 4; }
+  if (n >= 100) { pow10 = 100; return 3; }
+  if (n >= 10) { pow10 = 10; return 2; }
+  pow10 = 1;
+  return 1;
+}
+
+inline void round(char* buf, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenK) {
+  while (rest < dist && delta - rest >= tenK
+         && (rest + tenK < dist || dist - rest > rest + tenK - dist)) {
+    --buf[length - 1];
+    rest += tenK;
+  }
+}
+
+inline void generateDigits(char* buf, int& length, int& decimalExponent, DiyFp mMinus, DiyFp w, DiyFp mPlus) {
+  uint64_t delta = DiyFp::sub(mPlus, mMinus).f;
+  uint64_t dist = DiyFp::sub(mPlus, w).f;
+
+  const DiyFp one{uint64_t(1) << -mPlus.e, mPlus.e};
+  uint32_t p1 = static_cast<uint32_t>(mPlus.f >> -one.e);
+  uint64_t p2 = mPlus.f & (one.f - 1);
+
+  uint32_t pow10;
+  int n = largestPow10(p1, pow10);
+  while (n > 0) {
+    buf[length++] = static_cast<char>('0' + p1 / pow10);
+    p1 %= pow10;
+    --n;
+    const uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      decimalExponent += n;
+      round(buf, length, dist, delta, rest, uint64_t(pow10) << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  for (;;) {
+    p2 *= 10;
+    buf[length++] = static_cast<char>('0' + (p2 >> -one.e));
+    p2 &= one.f - 1;
+    ++m;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta)
+      break;
+  }
+  decimalExponent -= m;
+  round(buf, length, dist, delta, p2, one.f);
+}
+
+template <typename Float>
+void digits(char* buf, int& length, int& decimalExponent, Float value) {
+  const Boundaries b = computeBoundaries(value);
+  const CachedPower cached = cachedPowerFor(b.plus.e);
+  const DiyFp c{cached.f, cached.e};
+
+  const DiyFp w = DiyFp::mul(b.w, c);
+  const DiyFp wMinus = DiyFp::mul(b.minus, c);
+  const DiyFp wPlus = DiyFp::mul(b.plus, c);
+
+  decimalExponent = -cached.k;
+  generateDigits(buf, length, decimalExponent,
+                 DiyFp{wMinus.f + 1, wMinus.e}, w, DiyFp{wPlus.f - 1, wPlus.e});
+}
+
+inline char* appendExponent(char* out, int e) {
+  if (e < 0) {
+    e = -e;
+    *out++ = '-';
+  } else {
+    *out++ = '+';
+  }
+  if (e >= 100) {
+    *out++ = static_cast<char>('0' + e / 100);
+    e %= 100;
+  }
+  std::memcpy(out, digitPairs() + 2 * e, 2);
+  return out + 2;
+}
+
+// Lays out the digits d1..dk of d1.d2..dk * 10^(n-1): plainly for
+// small exponents, "1.5e+20" otherwise. Integral values keep a ".0".
+inline char* layout(char* buf, int k, int decimalExponent, int minExponent, int maxExponent) {
+  const int n = k + decimalExponent;
+
+  if (k <= n && n <= maxExponent) {
+    std::memset(buf + k, '0', n - k);
+    buf[n] = '.';
+    buf[n + 1] = '0';
+    return buf + n + 2;
+  }
+  if (0 < n && n <= maxExponent) {
+    std::memmove(buf + n + 1, buf + n, k - n);
+    buf[n] = '.';
+    return buf + k + 1;
+  }
+  if (minExponent < n && n <= 0) {
+    std::memmove(buf + 2 - n, buf, k);
+    buf[0] = '0';
+    buf[1] = '.';
+    std::memset(buf + 2, '0', -n);
+    return buf + 2 - n + k;
+  }
+
+  if (k == 1) {
+    ++buf;
+  } else {
+    std::memmove(buf + 2, buf + 1, k - 1);
+    buf[1] = '.';
+    buf += k + 1;
+  }
+  *buf++ = 'e';
+  return appendExponent(buf, n - 1);
+}
+
+} // namespace grisu
+
+template <typename Float>
+char* formatShortest(Float value, char* out) {
+  if (std::isnan(value)) {
+    std::memcpy(out, "nan", 3);
+    return out + 3;
+  }
+  if (std::signbit(value)) {
+    value = -value;
+    *out++ = '-';
+  }
+  if (std::isinf(value)) {
+    std::memcpy(out, "inf", 3);
+    return out + 3;
+  }
+  if (value == 0) {
+    std::memcpy(out, "0.0", 3);
+    return out + 3;
+  }
+  int length = 0;
+  int decimalExponent = 0;
+  grisu::digits(out, length, decimalExponent, value);
+  return grisu::layout(out, length, decimalExponent, -4, std::numeric_limits<Float>::digits10);
+}
+
+} // namespace detail
+
+inline char* formatDecimal(unsigned long long v, char* out) {
+  const char* pairs = detail::digitPairs();
+  char* const end = out + detail::decimalLength(v);
+  char* it = end;
+  while (v >= 100) {
+    const unsigned pair = static_cast<unsigned>(v % 100) * 2;
+    v /= 100;
+    *--it = pairs[pair + 1];
+    *--it = pairs[pair];
+  }
+  if (v >= 10) {
+    *--it = pairs[v * 2 + 1];
+    *--it = pairs[v * 2];
+  } else {
+    *--it = static_cast<char>('0' + v);
+  }
+  return end;
+}
+
+inline char* formatDecimal(long long v, char* out) {
+  if (v < 0) {
+    *out++ = '-';
+    return formatDecimal(0ull - static_cast<unsigned long long>(v), out);
+  }
+  return formatDecimal(static_cast<unsigned long long>(v), out);
+}
+
+inline char* formatHex(unsigned long long v, char* out, bool upper = false) {
+  const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  unsigned length = 1;
+  while (length < 16 && (v >> (4 * length)) != 0)
+    ++length;
+  char* const end = out + length;
+  for (char* it = end; it != out; v >>= 4) {
+    *--it = digits[v & 0xF];
+  }
+  return end;
+}
+
+// Shortest text that reads back to the same value, e.g. "0.1", "1.0", "1e+21".
+inline char* formatShortest(double v, char* out) {
+  return detail::formatShortest(v, out);
+}
+
+inline char* formatShortest(float v, char* out) {
+  return detail::formatShortest(v, out);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, char*>::type
+formatNumber(T t, char* out) {
+  return formatDecimal(static_cast<long long>(t), out);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, char*>::type
+formatNumber(T t, char* out) {
+  return formatDecimal(static_cast<unsigned long long>(t), out);
+}
+
+inline char* formatNumber(float t, char* out) {
+  return formatShortest(t, out);
+}
+
+inline char* formatNumber(double t, char* out) {
+  return formatShortest(t, out);
+}
+
+inline char* formatNumber(long double t, char* out) {
+  return formatShortest(static_cast<double>(t), out);
+}
+
+} // namespace yall
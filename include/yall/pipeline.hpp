@@ -0,0 +1,139 @@
+#pragma once
+
+#include "yall/types.hpp"
+#include "yall/backends.hpp"
+#include "yall/fmt.hpp"
+#include "yall/layout.hpp"
+#include "yall/prefix.hpp"
+#include "yall/priority.hpp"
+
+#include <memory>
+#include <tuple>
+#include <utility>
+
+namespace yall {
+
+// Building blocks of a Pipeline. A stage is any object callable with
+// LoggerMessage&, the built-in ones do what the decorating backend of the same
+// purpose does. The last stage is expected to be a sink which consumes the message.
+namespace stage {
+
+class Prefix {
+public:
+  explicit Prefix(const std::string& prefix) : prefix(internPrefix(prefix)) {}
+  void operator()(LoggerMessage& msg) const {
+    msg.meta.prefix = prefix;
+  }
+private:
+  const std::string* prefix;
+};
+
+class SetPriority {
+public:
+  explicit SetPriority(Priority p) : priority(p) {}
+  void operator()(LoggerMessage& msg) const {
+    msg.meta.setPriority(priority);
+  }
+private:
+  Priority priority;
+};
+
+struct EvaluateFmt {
+  void operator()(LoggerMessage& msg) const {
+    evaluateFmt(msg);
+  }
+};
+
+struct EvaluateCaptures {
+  void operator()(LoggerMessage& msg) const {
+    materialize(msg);
+  }
+};
+
+class FormatMeta {
+public:
+  explicit FormatMeta(
+    const std::string& pattern = Layout::defaultPattern(),
+    TimeStampFormatter timeFormatter = TimeStampFormatter::local()
+  ) : layout(pattern, timeFormatter) {}
+  void operator()(LoggerMessage& msg) const {
+    applyLayout(layout, msg);
+  }
+private:
+  Layout layout;
+};
+
+class Stream {
+public:
+  explicit Stream(std::shared_ptr<std::ostream> ostream) : stream(ostream) {}
+  void operator()(LoggerMessage& msg) const {
+    writeLine(*stream, msg);
+  }
+private:
+  std::shared_ptr<std::ostream> stream;
+};
+
+struct Null {
+  void operator()(LoggerMessage&) const {}
+};
+
+// Hands the message over to a runtime composed chain.
+class Forward {
+public:
+  explicit Forward(std::shared_ptr<LoggerBackend> backend) : backend(backend) {}
+  void operator()(LoggerMessage& msg) const {
+    backend->take(std::move(msg));
+  }
+private:
+  std::shared_ptr<LoggerBackend> backend;
+};
+
+} // namespace stage
+
+// A chain of stages fixed at compile time, run without virtual calls,
+// so that the compiler can inline it as a whole.
+template <typename ...Stages>
+class Pipeline {
+public:
+  explicit Pipeline(Stages... stages) : stages(std::move(stages)...) {}
+
+  void operator()(LoggerMessage& msg) {
+    run(msg, std::index_sequence_for<Stages...>());
+  }
+
+private:
+  template <size_t ...I>
+  void run(LoggerMessage& msg, std::index_sequence<I...>) {
+    using expand = int[];
+    (void)expand{0, (std::get<I>(stages)(msg), 0)...};
+  }
+
+  std::tuple<Stages...> stages;
+};
+
+// A Pipeline behind a single virtual call, usable wherever a backend is.
+template <typename ...Stages>
+class PipelineBackend final : public LoggerBackend {
+public:
+  explicit PipelineBackend(Stages... stages) : pipeline(std::move(stages)...) {}
+
+  void take(LoggerMessage&& msg) override {
+    pipeline(msg);
+  }
+
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    for (; first != last; ++first) {
+      pipeline(*first);
+    }
+  }
+private:
+  Pipeline<Stages...> pipeline;
+};
+
+// makePipeline(stage::Prefix("app"), stage::EvaluateFmt(), stage::FormatMeta(), stage::Stream(out))
+template <typename ...Stages>
+std::shared_ptr<PipelineBackend<Stages...>> makePipeline(Stages... stages) {
+  return std::make_shared<PipelineBackend<Stages...>>(std::move(stages)...);
+}
+
+} // namespace yall
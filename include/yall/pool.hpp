@@ -0,0 +1,114 @@
+#pragma once
+
+#include "yall/types.hpp"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace yall {
+
+// Recycles LoggerMessage objects, so that the heap storage of sequences that
+// outgrew their inline room survives from one message to the next.
+//
+// Every thread keeps a small cache of free messages. A thread that releases
+// more than it acquires (e.g. the worker of an AsyncBackend) moves whole
+// batches to a shared depot, from where threads with an empty cache refill.
+// The depot mutex is taken once per batch, not once per message.
+class MessagePool {
+public:
+  enum : size_t {
+    batchSize = 16,
+    maxDepotBatches = 64,
+    maxRecycledFields = 64
+  };
+
+  static LoggerMessage acquire() {
+    Batch* local = cache();
+    if (!local)
+      return LoggerMessage();
+    if (local->empty())
+      refill(*local);
+    if (local->empty())
+      return LoggerMessage();
+
+    LoggerMessage msg(std::move(local->back()));
+    local->pop_back();
+    return msg;
+  }
+
+  // Only messages whose fields spilled to the heap are kept: inline storage
+  // comes with every new message, and unusually large storage is not worth holding on to.
+  static void release(LoggerMessage&& msg) {
+    if (!msg.sequence.onHeap() || msg.sequence.capacity() > maxRecycledFields)
+      return;
+
+    Batch* local = cache();
+    if (!local)
+      return;
+    if (local->size() >= 2 * batchSize)
+      spill(*local);
+
+    msg.clear();
+    local->push_back(std::move(msg));
+  }
+
+private:
+  using Batch = std::vector<LoggerMessage>;
+
+  struct Depot {
+    std::mutex mutex;
+    std::vector<Batch> batches;
+  };
+
+  struct Cache {
+    Batch batch;
+    ~Cache() { gone() = true; }
+  };
+
+  // Trivially destructible, so it can still be read after the cache of the thread is destroyed.
+  static bool& gone() {
+    thread_local bool flag = false;
+    return flag;
+  }
+
+  // Null once the thread is exiting and its cache is destroyed (e.g. a logger used by the
+  // destructor of a static object), such messages are plainly allocated and freed.
+  static Batch* cache() {
+    if (gone())
+      return nullptr;
+    thread_local Cache local;
+    return &local.batch;
+  }
+
+  // Leaked on purpose, threads may release messages during static destruction.
+  static Depot& depot() {
+    static Depot* d = new Depot();
+    return *d;
+  }
+
+  static void refill(Batch& local) {
+    Depot& d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (d.batches.empty())
+      return;
+    local.swap(d.batches.back());
+    d.batches.pop_back();
+  }
+
+  static void spill(Batch& local) {
+    Batch batch;
+    batch.reserve(batchSize);
+    for (size_t i = 0; i < batchSize; ++i) {
+      batch.push_back(std::move(local.back()));
+      local.pop_back();
+    }
+
+    Depot& d = depot();
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (d.batches.size() < maxDepotBatches)
+      d.batches.push_back(std::move(batch));
+  }
+};
+
+} // namespace yall
@@ -1,39 +1,187 @@
 #pragma once
 #include "yall/logger.hpp"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
 namespace yall {
 
+// Messages refer to prefixes by pointer, also after the backend which attached them is gone.
+inline const std::string* internPrefix(const std::string& prefix) {
+  return detail::intern(prefix);
+}
+
 class PrefixDecoratingBackend: public LoggerBackend {
 public:
   PrefixDecoratingBackend(std::shared_ptr<LoggerBackend> toDecorate, const std::string& prefix):
-    decorated(toDecorate), prefix(prefix) {}
+    decorated(toDecorate), prefix(internPrefix(prefix)) {}
 
   void take(LoggerMessage&& msg) override {
-    msg.meta["yall::Prefix"] = prefix;
+    msg.meta.prefix = prefix;
     decorated->take(std::move(msg));
   }
 
+  void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+    for (auto it = first; it != last; ++it) {
+      it->meta.prefix = prefix;
+    }
+    decorated->takeBatch(first, last);
+  }
+
   std::shared_ptr<PrefixDecoratingBackend> getChild(const std::string& name) const {
-    return std::make_shared<PrefixDecoratingBackend>(decorated, prefix + '.' + name);
+    return std::make_shared<PrefixDecoratingBackend>(decorated, *prefix + '.' + name);
   }
 private:
   std::shared_ptr<LoggerBackend> decorated;
-  std::string prefix;
+  const std::string* prefix;
 };
 
-class PrefixedLogger: public Logger {
-  PrefixedLogger(std::shared_ptr<PrefixDecoratingBackend> backend):
-    Logger(backend), prefixBackend(backend) {}
+// A node of the process wide logger tree, e.g. "root.db.pool". Nodes are made
+// on first use and never freed, so handles keep them by pointer and the full
+// name is built and interned once. Finding an existing child takes no lock.
+//
+// Every node has a threshold. Until one is set on the node itself it follows
+// the parent's, and a change moves along all descendants that follow it.
+class LoggerNode: public ThresholdOwner {
+public:
+  static LoggerNode& root() {
+    static LoggerNode* node = new LoggerNode(nullptr, "root");
+    return *node;
+  }
+
+  // The name may be a dotted path, child("db.pool") is child("db").child("pool").
+  LoggerNode& child(const std::string& name) {
+    LoggerNode* node = this;
+    size_t begin = 0;
+    for (;;) {
+      const size_t dot = name.find('.', begin);
+      const size_t end = dot == std::string::npos ? name.size() : dot;
+      if (end == begin)
+        throw std::invalid_argument("yall: empty logger name in '" + name + "'");
+      node = &node->directChild(name.data() + begin, end - begin);
+      if (dot == std::string::npos)
+        return *node;
+      begin = dot + 1;
+    }
+  }
+
+  const std::string& name() const { return *fullName; }
+  const std::string* internedName() const { return fullName; }
+  LoggerNode* parent() const { return parentNode; }
 
+  Priority getThreshold() const {
+    return threshold.load(std::memory_order_relaxed);
+  }
+
+  void setThreshold(Priority p) override {
+    std::lock_guard<std::mutex> lock(treeMutex());
+    ownThreshold = true;
+    propagate(p);
+  }
+
+  // Follow the parent again.
+  void resetThreshold() {
+    std::lock_guard<std::mutex> lock(treeMutex());
+    ownThreshold = false;
+    propagate(parentNode ? parentNode->getThreshold() : Priority::Debug);
+  }
+
+  // The threshold in the form Logger shares it. It owns nothing, nodes are never freed.
+  std::shared_ptr<std::atomic<Priority>> sharedThreshold() {
+    return std::shared_ptr<std::atomic<Priority>>(std::shared_ptr<void>(), &threshold);
+  }
+
+  LoggerNode(const LoggerNode&) = delete;
+  LoggerNode& operator=(const LoggerNode&) = delete;
+
+private:
+  LoggerNode(LoggerNode* aParent, std::string aSegment)
+    : parentNode(aParent),
+      segment(std::move(aSegment)),
+      fullName(internPrefix(aParent ? aParent->name() + '.' + segment : segment)),
+      threshold(aParent ? aParent->getThreshold() : Priority::Debug),
+      firstChild(nullptr) {}
+
+  LoggerNode& directChild(const char* part, size_t length) {
+    if (LoggerNode* found = findChild(part, length))
+      return *found;
+    std::lock_guard<std::mutex> lock(treeMutex());
+    if (LoggerNode* found = findChild(part, length))
+      return *found;
+    auto node = new LoggerNode(this, std::string(part, length));
+    node->nextSibling = firstChild.load(std::memory_order_relaxed);
+    firstChild.store(node, std::memory_order_release);
+    return *node;
+  }
+
+  // Children are only ever prepended, a sibling link does not change once published.
+  LoggerNode* findChild(const char* part, size_t length) const {
+    for (LoggerNode* n = firstChild.load(std::memory_order_acquire); n; n = n->nextSibling) {
+      if (n->segment.size() == length && n->segment.compare(0, length, part, length) == 0)
+        return n;
+    }
+    return nullptr;
+  }
+
+  // Called with treeMutex held.
+  void propagate(Priority p) {
+    threshold.store(p, std::memory_order_relaxed);
+    for (LoggerNode* n = firstChild.load(std::memory_order_relaxed); n; n = n->nextSibling) {
+      if (!n->ownThreshold)
+        n->propagate(p);
+    }
+  }
+
+  // Guards creation of nodes and threshold changes. Leaked, like the nodes.
+  static std::mutex& treeMutex() {
+    static auto* mutex = new std::mutex();
+    return *mutex;
+  }
+
+  LoggerNode* const parentNode;
+  const std::string segment;
+  const std::string* const fullName;
+  std::atomic<Priority> threshold;
+  bool ownThreshold = false;
+  std::atomic<LoggerNode*> firstChild;
+  LoggerNode* nextSibling = nullptr;
+};
+
+// Logger bound to a node of the logger tree: its messages carry the node's
+// name as prefix and it follows the node's threshold. A handle is a Logger and
+// a pointer, nothing is allocated for a child. Finding a child still compares
+// names, so hot code should keep its handle around rather than look it up per message.
+class PrefixedLogger: public Logger {
 public:
-  PrefixedLogger(std::shared_ptr<LoggerBackend> backend):
-    PrefixedLogger(std::make_shared<PrefixDecoratingBackend>(backend, "root")) {}
+  PrefixedLogger(std::shared_ptr<LoggerBackend> backend, Capture aCapture = Capture::Eager):
+    PrefixedLogger(Logger(std::move(backend), aCapture), LoggerNode::root()) {}
 
-  PrefixedLogger child(const std::string& name) {
-    return PrefixedLogger(prefixBackend->getChild(name));
+  PrefixedLogger child(const std::string& name) const {
+    return PrefixedLogger(*this, node->child(name));
   }
+
+  LoggerNode& getNode() const {
+    return *node;
+  }
+
+  // setThreshold, also called through Logger, applies to every logger bound to
+  // the node and to the descendants following it. This undoes it.
+  void resetThreshold() {
+    node->resetThreshold();
+  }
+
 private:
-  std::shared_ptr<PrefixDecoratingBackend> prefixBackend;
+  PrefixedLogger(const Logger& logger, LoggerNode& aNode):
+    Logger(logger), node(&aNode) {
+    threshold = node->sharedThreshold();
+    thresholdOwner = node;
+    prefix = node->internedName();
+  }
+
+  LoggerNode* node;
 };
 
 } // namespace yall
@@ -9,17 +9,10 @@
 
 namespace yall {
 
-  enum class Priority {
-    Debug,
-    Info,
-    Warning,
-    Error
-  };
-
   template <>
   struct isLogMetaData<Priority> : std::true_type {};
 
-  inline std::string toString(const Priority& p) {
+  inline const char* priorityName(Priority p) {
     switch(p) {
       case Priority::Debug: return "debug";
       case Priority::Info: return "info";
@@ -29,8 +22,17 @@ namespace yall {
     throw std::logic_error("enum not handled, where is your Werror?");
   }
 
-  inline std::string typeString(const Priority&) {
-    return "yall::Priority";
+  inline std::string toString(const Priority& p) {
+    return priorityName(p);
+  }
+
+  inline TypeTag typeTag(const Priority&) {
+    static const TypeTag tag("yall::Priority");
+    return tag;
+  }
+
+  inline void attachMeta(MessageMeta& meta, Priority p) {
+    meta.setPriority(p);
   }
 
   class PriorityDecoratingBackend: public LoggerBackend {
@@ -43,10 +45,17 @@ namespace yall {
     }
 
     void take(LoggerMessage&& msg) override {
-      msg.meta["yall::Priority"] = toString(priority);
+      msg.meta.setPriority(priority);
       decorated->take(std::move(msg));
     }
 
+    void takeBatch(LoggerMessage* first, LoggerMessage* last) override {
+      for (auto it = first; it != last; ++it) {
+        it->meta.setPriority(priority);
+      }
+      decorated->takeBatch(first, last);
+    }
+
   private:
     std::shared_ptr<LoggerBackend> decorated;
     Priority priority;
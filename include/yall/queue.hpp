@@ -0,0 +1,326 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace yall {
+namespace detail {
+
+constexpr size_t cacheLine = 64;
+
+inline size_t roundUpToPowerOfTwo(size_t n) {
+  size_t ret = 1;
+  while (ret < n) ret <<= 1;
+  return ret;
+}
+
+// Bounded lock-free queue after D. Vyukov: every cell carries a sequence number
+// telling producers and consumers whose turn it is, so the only contended
+// operations are the CAS on the enqueue and dequeue positions.
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t minCapacity)
+    : mask(roundUpToPowerOfTwo(minCapacity < 2 ? 2 : minCapacity) - 1),
+      cells(new Cell[mask + 1]),
+      enqueuePos(0),
+      dequeuePos(0) {
+    for (size_t i = 0; i <= mask; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  // Leaves t untouched when the queue is full.
+  bool tryPush(T&& t) {
+    Cell* cell;
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = std::move(t);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(T& t) {
+    Cell* cell;
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells[pos & mask];
+      size_t seq = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeuePos.load(std::memory_order_relaxed);
+      }
+    }
+    t = std::move(cell->data);
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of slots ever claimed by producers, published or not.
+  size_t enqueued() const {
+    return enqueuePos.load(std::memory_order_acquire);
+  }
+
+  // Approximate; a claimed but not yet published slot counts as non-empty.
+  bool empty() const {
+    return enqueuePos.load(std::memory_order_acquire)
+      == dequeuePos.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const {
+    return mask + 1;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  const size_t mask;
+  std::unique_ptr<Cell[]> cells;
+  char pad0[cacheLine];
+  std::atomic<size_t> enqueuePos;
+  char pad1[cacheLine - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeuePos;
+  char pad2[cacheLine - sizeof(std::atomic<size_t>)];
+};
+
+// Bounded ring for exactly one producer and one consumer thread. Each side
+// keeps its own copy of the other side's position and rereads the shared one
+// only when the ring looks full (or empty), so while the ring is neither the
+// two threads do not touch each other's cache lines.
+template <typename T>
+class SpscRing {
+public:
+  explicit SpscRing(size_t minCapacity)
+    : mask(roundUpToPowerOfTwo(minCapacity < 2 ? 2 : minCapacity) - 1),
+      slots(new T[mask + 1]),
+      tail(0), headSeen(0), head(0), tailSeen(0) {}
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Producer only. Leaves t untouched when the ring is full.
+  bool tryPush(T&& t) {
+    const size_t pos = tail.load(std::memory_order_relaxed);
+    if (pos - headSeen > mask) {
+      headSeen = head.load(std::memory_order_acquire);
+      if (pos - headSeen > mask)
+        return false;
+    }
+    slots[pos & mask] = std::move(t);
+    tail.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. The oldest element, or nullptr when there is none; it stays
+  // in the ring until pop(), the consumer may move from it before that.
+  T* front() {
+    const size_t pos = head.load(std::memory_order_relaxed);
+    if (pos == tailSeen) {
+      tailSeen = tail.load(std::memory_order_acquire);
+      if (pos == tailSeen)
+        return nullptr;
+    }
+    return &slots[pos & mask];
+  }
+
+  // Consumer only, after front() returned an element.
+  void pop() {
+    head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  // Number of elements ever pushed; any thread.
+  size_t pushed() const {
+    return tail.load(std::memory_order_acquire);
+  }
+
+  // Any thread.
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  // Consumer only.
+  bool full() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed) > mask;
+  }
+
+  size_t capacity() const {
+    return mask + 1;
+  }
+
+private:
+  const size_t mask;
+  std::unique_ptr<T[]> slots;
+  char pad0[cacheLine];
+  // Written by the producer.
+  std::atomic<size_t> tail;
+  size_t headSeen;
+  char pad1[cacheLine - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  // Written by the consumer.
+  std::atomic<size_t> head;
+  size_t tailSeen;
+  char pad2[cacheLine - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+// A BoundedQueue drained by a dedicated thread. Producers never take a lock
+// unless the queue is full or the consumer went to sleep waiting for work.
+// The consumer gets [first, last) of up to maxBatch items which were queued
+// at the time, it may move from them. Destruction drains everything that was pushed.
+// The optional tick runs on the consumer thread between batches and at least
+// every 10 ms while the queue is empty.
+template <typename T>
+class QueueWorker {
+public:
+  using Consumer = std::function<void(T* first, T* last)>;
+  using Tick = std::function<void()>;
+
+  enum : size_t { defaultMaxBatch = 256 };
+
+  QueueWorker(size_t capacity, Consumer aConsume, size_t maxBatch = defaultMaxBatch, Tick aTick = Tick())
+    : consume(std::move(aConsume)), tick(std::move(aTick)), queue(capacity),
+      batch(maxBatch < 1 ? 1 : maxBatch), completed(0), waiting(false), stopping(false),
+      worker(&QueueWorker::run, this) {}
+
+  QueueWorker(const QueueWorker&) = delete;
+  QueueWorker& operator=(const QueueWorker&) = delete;
+
+  ~QueueWorker() {
+    stopping.store(true);
+    wake();
+    worker.join();
+  }
+
+  // Spins while the queue is full.
+  void push(T&& t) {
+    while (!queue.tryPush(std::move(t))) {
+      wake();
+      std::this_thread::yield();
+    }
+    notify();
+  }
+
+  bool tryPush(T&& t) {
+    if (!queue.tryPush(std::move(t)))
+      return false;
+    notify();
+    return true;
+  }
+
+  // Spins while the queue is full, but not past the deadline.
+  bool pushUntil(T&& t, std::chrono::steady_clock::time_point deadline) {
+    while (!queue.tryPush(std::move(t))) {
+      if (std::chrono::steady_clock::now() >= deadline)
+        return false;
+      wake();
+      std::this_thread::yield();
+    }
+    notify();
+    return true;
+  }
+
+  // Takes the oldest queued item away from the consumer, e.g. to make room.
+  bool tryPopOldest(T& t) {
+    if (!queue.tryPop(t))
+      return false;
+    completed.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  // Blocks until everything pushed before the call was consumed.
+  void flush() {
+    const size_t target = queue.enqueued();
+    while (completed.load(std::memory_order_acquire) < target) {
+      wake();
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed))
+      wake();
+  }
+
+  void wake() {
+    std::lock_guard<std::mutex> lock(mutex);
+    wakeUp.notify_one();
+  }
+
+  void run() {
+    for (;;) {
+      if (tick)
+        tick();
+      size_t n = 0;
+      while (n < batch.size() && queue.tryPop(batch[n])) {
+        ++n;
+      }
+      if (n != 0) {
+        try {
+          consume(batch.data(), batch.data() + n);
+        } catch (...) {
+          // Nobody to report to on this thread; losing a batch beats terminating.
+        }
+        completed.fetch_add(n, std::memory_order_release);
+        continue;
+      }
+      if (!queue.empty()) {
+        // A producer claimed a slot but has not published it yet.
+        std::this_thread::yield();
+        continue;
+      }
+      if (stopping.load())
+        return;
+
+      std::unique_lock<std::mutex> lock(mutex);
+      waiting.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (queue.empty() && !stopping.load())
+        wakeUp.wait_for(lock, std::chrono::milliseconds(10));
+      waiting.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  Consumer consume;
+  Tick tick;
+  BoundedQueue<T> queue;
+  std::vector<T> batch;
+  std::atomic<size_t> completed;
+  std::atomic<bool> waiting;
+  std::atomic<bool> stopping;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::thread worker;
+};
+
+} // namespace detail
+} // namespace yall
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "yall/logger.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+namespace yall {
+
+// Policies deciding per occurrence whether a call site logs. Each lives in a
+// static made on first use of its site (see YALL_LOG_EVERY_N and friends), so
+// admit() may be called by any thread and takes no lock.
+namespace sample {
+
+// Occurrences 1, n + 1, 2n + 1, ...
+class EveryN {
+public:
+  explicit EveryN(unsigned long long n): n(n), seen(0) {
+    if (n == 0)
+      throw std::invalid_argument("yall: EveryN needs n > 0");
+  }
+
+  bool admit() {
+    return seen.fetch_add(1, std::memory_order_relaxed) % n == 0;
+  }
+
+private:
+  const unsigned long long n;
+  std::atomic<unsigned long long> seen;
+};
+
+// The first n occurrences, then quiet for good.
+class FirstN {
+public:
+  explicit FirstN(unsigned long long n): n(n), seen(0) {}
+
+  bool admit() {
+    // Once quiet the counter is only read, it does not run on and wrap.
+    if (seen.load(std::memory_order_relaxed) >= n)
+      return false;
+    return seen.fetch_add(1, std::memory_order_relaxed) < n;
+  }
+
+private:
+  const unsigned long long n;
+  std::atomic<unsigned long long> seen;
+};
+
+// Token bucket holding perSecond tokens and refilled at perSecond a second:
+// bursts of up to perSecond, perSecond a second on average. Kept as the time
+// the bucket is next full minus one token, so taking a token is one CAS.
+class RateLimit {
+public:
+  explicit RateLimit(unsigned perSecond)
+    : interval(perSecond ? 1000000000 / perSecond : 0),
+      tolerance(interval * (static_cast<std::int64_t>(perSecond) - 1)),
+      next(0) {
+    if (perSecond == 0)
+      throw std::invalid_argument("yall: RateLimit needs a rate > 0");
+  }
+
+  bool admit() {
+    const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::int64_t due = next.load(std::memory_order_relaxed);
+    for (;;) {
+      const std::int64_t start = due > now ? due : now;
+      if (start - now > tolerance)
+        return false;
+      if (next.compare_exchange_weak(due, start + interval, std::memory_order_relaxed))
+        return true;
+    }
+  }
+
+private:
+  const std::int64_t interval;  // ns per token
+  const std::int64_t tolerance;
+  std::atomic<std::int64_t> next;
+};
+
+} // namespace sample
+
+// A call site limited by Policy. Suppressed occurrences are counted, and the
+// first one admitted afterwards is preceded by a message of the same priority
+// telling how many the site held back.
+template <typename Policy>
+class SampledSite: private Policy {
+public:
+  template <typename ...Args>
+  SampledSite(const char* aFile, int aLine, Args&&... args)
+    : Policy(std::forward<Args>(args)...), file(aFile), line(aLine), suppressed(0) {}
+
+  SampledSite(const SampledSite&) = delete;
+  SampledSite& operator=(const SampledSite&) = delete;
+
+  bool admit(const Logger& logger, Priority priority) {
+    if (!Policy::admit()) {
+      suppressed.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (suppressed.load(std::memory_order_relaxed) != 0) {
+      if (const unsigned long long count = suppressed.exchange(0, std::memory_order_relaxed))
+        logger.log(priority, "suppressed ", count, " messages at ", file, ':', line);
+    }
+    return true;
+  }
+
+  unsigned long long getSuppressed() const {
+    return suppressed.load(std::memory_order_relaxed);
+  }
+
+private:
+  const char* const file;
+  const int line;
+  std::atomic<unsigned long long> suppressed;
+};
+
+} // namespace yall
+
+// Site state is a static local of a lambda unique to the expansion; after the
+// first call reaching it, getting to it is a check of the initialisation guard.
+// The policy is consulted only for enabled priorities and, as with YALL_LOG,
+// the arguments are not evaluated when the occurrence is suppressed.
+#define YALL_DETAIL_SAMPLED(logger, priority, Policy, ...) \
+  if (!(logger).enabled(priority)) {} \
+  else if (!([&]() -> ::yall::SampledSite<Policy>& { \
+      static ::yall::SampledSite<Policy> site(__FILE__, __LINE__, __VA_ARGS__); \
+      return site; \
+    }()).admit((logger), (priority))) {} \
+  else
+
+#define YALL_LOG_EVERY_N(logger, priority, n, ...) \
+  YALL_DETAIL_SAMPLED(logger, priority, ::yall::sample::EveryN, n) (logger).log((priority), __VA_ARGS__)
+
+#define YALL_LOG_FIRST_N(logger, priority, n, ...) \
+  YALL_DETAIL_SAMPLED(logger, priority, ::yall::sample::FirstN, n) (logger).log((priority), __VA_ARGS__)
+
+#define YALL_LOG_RATE(logger, priority, perSecond, ...) \
+  YALL_DETAIL_SAMPLED(logger, priority, ::yall::sample::RateLimit, perSecond) (logger).log((priority), __VA_ARGS__)
+
+#define YALL_STREAM_EVERY_N(logger, priority, n) \
+  YALL_DETAIL_SAMPLED(logger, priority, ::yall::sample::EveryN, n) (logger)(priority)
+
+#define YALL_STREAM_FIRST_N(logger, priority, n) \
+  YALL_DETAIL_SAMPLED(logger, priority, ::yall::sample::FirstN, n) (logger)(priority)
+
+#define YALL_STREAM_RATE(logger, priority, perSecond) \
+  YALL_DETAIL_SAMPLED(logger, priority, ::yall::sample::RateLimit, perSecond) (logger)(priority)
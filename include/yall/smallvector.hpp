@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace yall {
+
+// Vector keeping its first N elements inside the object. It goes to the heap
+// only once more than N elements are added, and keeps the heap buffer until
+// destroyed, the same way std::vector keeps its capacity.
+//
+// Only the operations the library uses are provided. Elements must be
+// nothrow move constructible, so that growing never leaves a half moved buffer.
+template <typename T, size_t N>
+class SmallVector {
+  static_assert(N > 0, "SmallVector needs room for at least one inline element");
+  static_assert(std::is_nothrow_move_constructible<T>::value,
+                "SmallVector elements have to be nothrow move constructible");
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  enum : size_t { inlineCapacity = N };
+
+  SmallVector() : first(inlineData()), count(0), room(N) {}
+
+  SmallVector(const SmallVector& rhs) : SmallVector() {
+    reserve(rhs.count);
+    std::uninitialized_copy(rhs.begin(), rhs.end(), first);
+    count = rhs.count;
+  }
+
+  SmallVector(SmallVector&& rhs) noexcept : SmallVector() {
+    takeFrom(rhs);
+  }
+
+  SmallVector& operator=(const SmallVector& rhs) {
+    if (this != &rhs) {
+      clear();
+      reserve(rhs.count);
+      std::uninitialized_copy(rhs.begin(), rhs.end(), first);
+      count = rhs.count;
+    }
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& rhs) noexcept {
+    if (this != &rhs) {
+      clear();
+      if (rhs.onHeap())
+        freeHeap();
+      takeFrom(rhs);
+    }
+    return *this;
+  }
+
+  ~SmallVector() {
+    clear();
+    freeHeap();
+  }
+
+  size_t size() const { return count; }
+  size_t capacity() const { return room; }
+  bool empty() const { return count == 0; }
+  // True once the elements outgrew the inline storage.
+  bool onHeap() const { return first != inlineData(); }
+
+  T* data() { return first; }
+  const T* data() const { return first; }
+  iterator begin() { return first; }
+  iterator end() { return first + count; }
+  const_iterator begin() const { return first; }
+  const_iterator end() const { return first + count; }
+
+  T& operator[](size_t i) { return first[i]; }
+  const T& operator[](size_t i) const { return first[i]; }
+  T& front() { return first[0]; }
+  const T& front() const { return first[0]; }
+  T& back() { return first[count - 1]; }
+  const T& back() const { return first[count - 1]; }
+
+  void reserve(size_t wanted) {
+    if (wanted > room)
+      grow(wanted, nullptr);
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (count == room) {
+      // The arguments may refer to an element, so the new one is built before the old ones move.
+      grow(2 * room, [&](T* slot) { ::new (slot) T(std::forward<Args>(args)...); });
+    } else {
+      ::new (first + count) T(std::forward<Args>(args)...);
+    }
+    return first[count++];
+  }
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  void pop_back() {
+    first[--count].~T();
+  }
+
+  iterator insert(const_iterator pos, T&& value) {
+    const size_t at = pos - first;
+    emplace_back(std::move(value));
+    std::rotate(first + at, first + count - 1, first + count);
+    return first + at;
+  }
+
+  // Destroys the elements, the capacity is kept.
+  void clear() {
+    for (size_t i = 0; i != count; ++i) {
+      first[i].~T();
+    }
+    count = 0;
+  }
+
+  bool operator==(const SmallVector& rhs) const {
+    return count == rhs.count && std::equal(begin(), end(), rhs.begin());
+  }
+
+  bool operator!=(const SmallVector& rhs) const {
+    return !(*this == rhs);
+  }
+
+private:
+  T* inlineData() { return reinterpret_cast<T*>(&storage); }
+  const T* inlineData() const { return reinterpret_cast<const T*>(&storage); }
+
+  // Moves to a heap buffer of at least wanted elements. When given, place
+  // constructs the element that goes at index count into the new buffer.
+  template <typename Place>
+  void grow(size_t wanted, Place place) {
+    const size_t newRoom = std::max(wanted, 2 * room);
+    T* buffer = static_cast<T*>(::operator new(newRoom * sizeof(T)));
+    try {
+      placeAt(place, buffer + count);
+    } catch (...) {
+      ::operator delete(buffer);
+      throw;
+    }
+    for (size_t i = 0; i != count; ++i) {
+      ::new (buffer + i) T(std::move(first[i]));
+      first[i].~T();
+    }
+    freeHeap();
+    first = buffer;
+    room = newRoom;
+  }
+
+  template <typename Place>
+  static void placeAt(Place& place, T* slot) { place(slot); }
+  static void placeAt(std::nullptr_t, T*) {}
+
+  // Expects this to be empty, and to be inline when rhs is on the heap.
+  void takeFrom(SmallVector& rhs) {
+    if (rhs.onHeap()) {
+      first = rhs.first;
+      room = rhs.room;
+      count = rhs.count;
+      rhs.first = rhs.inlineData();
+      rhs.room = N;
+      rhs.count = 0;
+      return;
+    }
+    for (size_t i = 0; i != rhs.count; ++i) {
+      ::new (first + i) T(std::move(rhs.first[i]));
+    }
+    count = rhs.count;
+    rhs.clear();
+  }
+
+  void freeHeap() {
+    if (onHeap()) {
+      ::operator delete(first);
+      first = inlineData();
+      room = N;
+    }
+  }
+
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type storage;
+  T* first;
+  size_t count;
+  size_t room;
+};
+
+} // namespace yall
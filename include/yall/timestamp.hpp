@@ -0,0 +1,165 @@
+#pragma once
+
+#include "yall/types.hpp"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+namespace yall {
+
+// Formats time stamps as "YYYY-MM-DD HH:MM:SS.mmm".
+// The part up to the seconds is cached per thread and rebuilt only when the
+// second changes, so the common case is a copy plus three digits. Local time
+// calls localtime_r once per second, UTC and fixed offsets do not touch the
+// time zone database at all.
+class TimeStampFormatter {
+public:
+  enum : size_t { length = 23 };
+
+  static TimeStampFormatter local() {
+    return TimeStampFormatter(Mode::Local, 0);
+  }
+
+  static TimeStampFormatter utc() {
+    return TimeStampFormatter(Mode::Offset, 0);
+  }
+
+  static TimeStampFormatter withOffset(std::chrono::seconds offset) {
+    return TimeStampFormatter(Mode::Offset, offset.count());
+  }
+
+  // Offset of the local time zone right now, for a withOffset formatter that
+  // ignores later daylight saving changes in exchange for never calling localtime.
+  static std::chrono::seconds currentLocalOffset() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm;
+    localtime_r(&now, &tm);
+    return std::chrono::seconds(tm.tm_gmtoff);
+  }
+
+  // Writes exactly length characters, returns the end.
+  char* format(TimeStamp t, char* out) const {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+    long long seconds = ms / 1000;
+    long long millis = ms % 1000;
+    if (millis < 0) {
+      millis += 1000;
+      --seconds;
+    }
+
+    Cache& c = cache();
+    if (c.second != seconds || c.mode != mode || c.offset != offset) {
+      refill(c, seconds);
+    }
+    std::memcpy(out, c.prefix, sizeof(c.prefix));
+    out += sizeof(c.prefix);
+    *out++ = '.';
+    *out++ = char('0' + millis / 100);
+    *out++ = char('0' + millis / 10 % 10);
+    *out++ = char('0' + millis % 10);
+    return out;
+  }
+
+  void append(std::string& out, TimeStamp t) const {
+    char buf[length];
+    out.append(buf, format(t, buf));
+  }
+
+  std::string operator()(TimeStamp t) const {
+    char buf[length];
+    return std::string(buf, format(t, buf));
+  }
+
+private:
+  enum class Mode {
+    Local,
+    Offset
+  };
+
+  struct Cache {
+    long long second = LLONG_MIN;
+    Mode mode = Mode::Local;
+    long long offset = 0;
+    char prefix[19];
+  };
+
+  TimeStampFormatter(Mode m, long long o) : mode(m), offset(o) {}
+
+  static Cache& cache() {
+    thread_local Cache c;
+    return c;
+  }
+
+  void refill(Cache& c, long long seconds) const {
+    int year, month, day, hour, minute, second;
+    if (mode == Mode::Local) {
+      std::time_t tt = static_cast<std::time_t>(seconds);
+      std::tm tm;
+      localtime_r(&tt, &tm);
+      year = tm.tm_year + 1900;
+      month = tm.tm_mon + 1;
+      day = tm.tm_mday;
+      hour = tm.tm_hour;
+      minute = tm.tm_min;
+      second = tm.tm_sec;
+    } else {
+      long long shifted = seconds + offset;
+      long long days = shifted / 86400;
+      long long rest = shifted % 86400;
+      if (rest < 0) {
+        rest += 86400;
+        --days;
+      }
+      civilFromDays(days, year, month, day);
+      hour = int(rest / 3600);
+      minute = int(rest / 60 % 60);
+      second = int(rest % 60);
+    }
+
+    char* p = c.prefix;
+    p = digits(p, year, 4);
+    *p++ = '-';
+    p = digits(p, month, 2);
+    *p++ = '-';
+    p = digits(p, day, 2);
+    *p++ = ' ';
+    p = digits(p, hour, 2);
+    *p++ = ':';
+    p = digits(p, minute, 2);
+    *p++ = ':';
+    digits(p, second, 2);
+
+    c.second = seconds;
+    c.mode = mode;
+    c.offset = offset;
+  }
+
+  static char* digits(char* out, int value, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+      out[i] = char('0' + value % 10);
+      value /= 10;
+    }
+    return out + width;
+  }
+
+  // H. Hinnant's days_from_civil inverse, days counted from 1970-01-01.
+  static void civilFromDays(long long z, int& year, int& month, int& day) {
+    z += 719468;
+    const long long era = (z >= 0 ? z : z - 146096) / 146097;
+    const long long doe = z - era * 146097;
+    const long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const long long mp = (5 * doy + 2) / 153;
+    day = int(doy - (153 * mp + 2) / 5 + 1);
+    month = int(mp < 10 ? mp + 3 : mp - 9);
+    year = int(yoe + era * 400 + (month <= 2));
+  }
+
+  Mode mode;
+  long long offset;
+};
+
+} // namespace yall
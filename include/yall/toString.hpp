@@ -1,13 +1,49 @@
 #pragma once
 
-#include <sstream>
+#include "yall/types.hpp"
+#include "yall/timestamp.hpp"
+#include "yall/numbers.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <ctime>
 #include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 
 namespace yall {
 
+namespace detail {
+
+// typeString(t) returning the name was the customization point before TypeTag.
+// Overloads of it found by argument dependent lookup still name the type;
+// new code overloads typeTag(const T&) instead, see priority.hpp.
+template <typename T, typename = void>
+struct hasTypeString : std::false_type {};
+
+template <typename T>
+struct hasTypeString<T, decltype(void(typeString(std::declval<const T&>())))> : std::true_type {};
+
+}
+
 template <typename T>
-std::string typeString(const T& t) {
-  return typeid(t).name();
+typename std::enable_if<!detail::hasTypeString<T>::value, TypeTag>::type
+typeTag(const T&) {
+  // Decayed, so that every string literal shares the tag of const char*.
+  static const TypeTag tag(typeid(typename std::decay<const T>::type).name());
+  return tag;
+}
+
+// The name is taken from the first value, typeString is expected to depend on the type only.
+template <typename T>
+typename std::enable_if<detail::hasTypeString<T>::value, TypeTag>::type
+typeTag(const T& t) {
+  static const TypeTag tag(typeString(t));
+  return tag;
 }
 
 inline std::string toString(const char* str) {
@@ -28,30 +64,42 @@ constexpr bool isNumberType() {
   return (std::is_integral<T>::value || std::is_floating_point<T>::value)
   && !(std::is_same<char, T>::value
   || std::is_same<unsigned char, T>::value
-  || std::is_same<wchar_t, T>::value
-  || std::is_same<unsigned wchar_t, T>::value);
+  || std::is_same<wchar_t, T>::value);
 }
 
 template <typename T>
 typename std::enable_if<isNumberType<T>(), std::string>::type
 toString(const T& t) {
-  return std::to_string(t);
+  char buf[maxNumberLength];
+  return std::string(buf, formatNumber(t, buf));
 }
 
 inline std::string toString(const std::chrono::system_clock::time_point& t) {
-  auto milis = std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
-  std::time_t time = std::chrono::system_clock::to_time_t(t);
-  std::tm tm = *std::localtime(&time);
-  std::stringstream buf;
-  buf << std::put_time(&tm, "%F %T")
-    << '.' << std::setfill('0') << std::setw(3) << milis % 1000;
-  return buf.str();
+  return TimeStampFormatter::local()(t);
 }
 
-inline std::string toString(const std::thread::id& id) {
+// Appends what toString(id) returns, without a temporary string on libstdc++.
+inline void appendThreadId(std::string& out, const std::thread::id& id) {
+#ifdef __GLIBCXX__
+  // libstdc++ prints the native handle, which is all std::thread::id holds.
+  static_assert(sizeof(id) == sizeof(unsigned long), "unexpected std::thread::id layout");
+  if (id != std::thread::id()) {
+    unsigned long handle;
+    std::memcpy(&handle, &id, sizeof(handle));
+    char buf[maxNumberLength];
+    out.append(buf, formatHex(handle, buf));
+    return;
+  }
+#endif
   std::stringstream buf;
   buf << std::hex << id;
-  return buf.str();
+  out += buf.str();
+}
+
+inline std::string toString(const std::thread::id& id) {
+  std::string ret;
+  appendThreadId(ret, id);
+  return ret;
 }
 
 } // namespace yall
@@ -1,39 +1,289 @@
 #pragma once
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <ostream>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
-#include <unordered_map>
 #include <type_traits>
 #include <chrono>
+#include <memory>
 #include <thread>
 
+#include "yall/smallvector.hpp"
+
 namespace yall {
   using TimeStamp = std::chrono::system_clock::time_point;
   using ThreadId = std::thread::id;
 
+  enum class Priority {
+    Debug,
+    Info,
+    Warning,
+    Error
+  };
+
+  namespace detail {
+    // Kept once for the lifetime of the process, so that it can be referred to by pointer.
+    // Deliberately leaked: messages may still be around during static destruction.
+    inline const std::string* intern(const std::string& str) {
+      static auto* mutex = new std::mutex();
+      static auto* strings = new std::unordered_set<std::string>();
+      std::lock_guard<std::mutex> lock(*mutex);
+      return &*strings->insert(str).first;
+    }
+  }
+
+  namespace detail {
+    // The part after the colon in "${n:spec}", see readSpec in fmt.hpp.
+    // Zero members were not given in the format string.
+    struct FmtSpec {
+      char fill;
+      char align;       // '<', '>', '^' or '=' (padding after the sign)
+      char sign;        // '+', '-' or ' '
+      bool zero;
+      bool thousands;
+      bool hasPrecision;
+      char type;        // 'd', 'x', 'X', 'o', 'b', 'f', 'e', 'g' or 's'
+      unsigned width;
+      unsigned precision;
+
+      bool empty() const {
+        return !fill && !align && !sign && !zero && !thousands && !hasPrecision && !type && !width;
+      }
+    };
+
+    // Format string split once at compile time (see MakeFmt): every segment is
+    // a literal part followed by a placeholder, index 0 marks a trailing literal.
+    struct FmtSegment {
+      size_t offset;
+      size_t length;
+      size_t index;
+      FmtSpec spec;
+    };
+
+    struct FmtLayout {
+      const char* string;
+      const FmtSegment* segments;
+      size_t count;
+      size_t literalLength;
+    };
+  }
+
+  // Identifies the type of a field by a pointer to its interned name,
+  // equal names give equal tags and comparing tags compares pointers.
+  // Get one through typeTag(t), which keeps it in a function local static.
+  class TypeTag {
+  public:
+    TypeTag() : tagName(emptyName()) {}
+    TypeTag(const char* name) : tagName(detail::intern(name)) {}
+    TypeTag(const std::string& name) : tagName(detail::intern(name)) {}
+
+    const std::string& name() const { return *tagName; }
+    const void* id() const { return tagName; }
+
+    bool operator==(const TypeTag& rhs) const { return tagName == rhs.tagName; }
+    bool operator!=(const TypeTag& rhs) const { return tagName != rhs.tagName; }
+
+  private:
+    static const std::string* emptyName() {
+      static const std::string* name = detail::intern(std::string());
+      return name;
+    }
+
+    const std::string* tagName;
+  };
+
+  inline bool operator==(const TypeTag& tag, const char* name) { return tag.name() == name; }
+  inline bool operator==(const char* name, const TypeTag& tag) { return tag.name() == name; }
+
+  inline std::ostream& operator<<(std::ostream& os, const TypeTag& tag) {
+    return os << tag.name();
+  }
+
+  namespace tags {
+    inline TypeTag fmt() { static const TypeTag tag("yall::Fmt"); return tag; }
+    inline TypeTag formatted() { static const TypeTag tag("yall::Formatted"); return tag; }
+    inline TypeTag prefix() { static const TypeTag tag("yall::Prefix"); return tag; }
+  }
+
+  // Native form of a field whose conversion to text was deferred to the backend.
+  // Kind::None means the text is already in TypeAndValue::value. Eager capture
+  // fills value in any case; a format string and the numbers and characters
+  // passed to it have their native form here as well.
+  struct CapturedValue {
+    enum class Kind : unsigned char {
+      None,
+      Signed,
+      Unsigned,
+      Floating,
+      Float,
+      Character,
+      StaticString,
+      Format
+    };
+
+    Kind kind = Kind::None;
+    union {
+      long long i = 0;
+      unsigned long long u;
+      double d;
+      float f;
+      char c;
+      const char* s;
+      const detail::FmtLayout* format;
+    };
+
+    bool operator==(const CapturedValue& rhs) const {
+      if (kind != rhs.kind) return false;
+      switch (kind) {
+        case Kind::None: return true;
+        case Kind::Signed: return i == rhs.i;
+        case Kind::Unsigned: return u == rhs.u;
+        case Kind::Floating: return d == rhs.d;
+        case Kind::Float: return f == rhs.f;
+        case Kind::Character: return c == rhs.c;
+        case Kind::StaticString: return s == rhs.s;
+        case Kind::Format: return format == rhs.format;
+      }
+      return false;
+    }
+  };
+
   struct TypeAndValue {
-    std::string type;
+    TypeTag type;
     std::string value;
+    CapturedValue captured;
 
     bool operator==(const TypeAndValue& rhs) const {
-      return type == rhs.type && value == rhs.value;
+      return type == rhs.type && value == rhs.value && captured == rhs.captured;
+    }
+  };
+
+  // Flat storage for metadata types the library does not know about, keyed by typeTag.
+  class UserMetaData {
+  public:
+    using Entry = std::pair<TypeTag, std::string>;
+    using Storage = SmallVector<Entry, 2>;
+
+    void set(TypeTag key, std::string value) {
+      for (auto& e : entries) {
+        if (e.first == key) {
+          e.second = std::move(value);
+          return;
+        }
+      }
+      entries.emplace_back(key, std::move(value));
+    }
+
+    const std::string* find(TypeTag key) const {
+      for (const auto& e : entries) {
+        if (e.first == key) return &e.second;
+      }
+      return nullptr;
+    }
+
+    size_t count(TypeTag key) const {
+      return find(key) ? 1 : 0;
+    }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+    Storage::const_iterator begin() const { return entries.begin(); }
+    Storage::const_iterator end() const { return entries.end(); }
+
+    bool operator==(const UserMetaData& rhs) const {
+      return size() == rhs.size()
+        && std::all_of(begin(), end(), [&rhs](const Entry& e) {
+          auto other = rhs.find(e.first);
+          return other && *other == e.second;
+        });
+    }
+
+  private:
+    Storage entries;
+  };
+
+  // Built-in metadata lives in typed slots and is formatted only by the backends printing it.
+  struct MessageMeta {
+    TimeStamp timeStamp;
+    ThreadId threadId;
+    Priority priority = Priority::Debug;
+    bool hasPriority = false;
+    const std::string* prefix = nullptr;  // interned, never freed
+    UserMetaData user;
+
+    void setPriority(Priority p) {
+      priority = p;
+      hasPriority = true;
+    }
+
+    // Messages without a priority count as debug, whatever priority holds.
+    Priority priorityOrDebug() const {
+      return hasPriority ? priority : Priority::Debug;
+    }
+
+    void clear() {
+      timeStamp = TimeStamp();
+      threadId = ThreadId();
+      priority = Priority::Debug;
+      hasPriority = false;
+      prefix = nullptr;
+      user.clear();
+    }
+
+    bool operator==(const MessageMeta& rhs) const {
+      return timeStamp == rhs.timeStamp
+        && threadId == rhs.threadId
+        && hasPriority == rhs.hasPriority
+        && (!hasPriority || priority == rhs.priority)
+        && prefix == rhs.prefix
+        && user == rhs.user;
     }
   };
 
   struct LoggerMessage {
-    using TypeAndValueSequence = std::vector<TypeAndValue>;
-    using KeyValueStorage = std::unordered_map<std::string, std::string>;
+    // Typical messages fit inline, so gathering them does not allocate for the fields.
+    using TypeAndValueSequence = SmallVector<TypeAndValue, 8>;
 
-    KeyValueStorage meta;
+    MessageMeta meta;
     TypeAndValueSequence sequence;
 
+    // Empties the message but keeps the capacity of its containers.
+    void clear() {
+      meta.clear();
+      sequence.clear();
+    }
+
     bool operator==(const LoggerMessage& rhs) const {
       return meta == rhs.meta && sequence == rhs.sequence;
     }
   };
 
+  using SharedMessage = std::shared_ptr<const LoggerMessage>;
+
   class LoggerBackend {
   public:
     virtual void take(LoggerMessage&& sequence) = 0;
+
+    // Receives a message which other backends see as well. Backends that only
+    // read override this; the default makes the private copy take() may modify.
+    virtual void takeShared(const SharedMessage& msg) {
+      take(LoggerMessage(*msg));
+    }
+
+    // Receives the messages in [first, last) in order, e.g. drained from a queue,
+    // and may move from them. Decorators override it to pass the whole batch on
+    // with one virtual call; the default hands the messages to take() one by one.
+    virtual void takeBatch(LoggerMessage* first, LoggerMessage* last) {
+      for (; first != last; ++first) {
+        take(std::move(*first));
+      }
+    }
+
     virtual ~LoggerBackend(){};
   };
 
@@ -1,6 +1,21 @@
 #include <benchmark/benchmark.h>
+#define YALL_COUNT_ALLOCATIONS
+#include "yall/allocations.hpp"
 #include "yall/logger.hpp"
 #include "yall/backends.hpp"
+#include "yall/priority.hpp"
+#include "yall/file.hpp"
+#include "yall/pipeline.hpp"
+#include "yall/merging.hpp"
+#include "yall/prefix.hpp"
+#include "yall/filter.hpp"
+#include "yall/sampling.hpp"
+#include "yall/dedup.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
 #include <sstream>
 #include <cstdio>
 #include <vector>
@@ -13,7 +28,97 @@ using namespace yall;
 
 namespace {
 
+// Reports heap allocations per iteration, i.e. per message for the logger benchmarks.
+// The count is process wide, so with Threads() only the first thread reports it,
+// against the iterations of all of them.
+struct AllocationCounter {
+  explicit AllocationCounter(benchmark::State& state) : state(state) {}
+  ~AllocationCounter() {
+    if (state.thread_index() != 0)
+      return;
+    state.counters["allocs/msg"] = benchmark::Counter(
+      double(counter.count()), benchmark::Counter::kAvgIterations);
+  }
+  benchmark::State& state;
+  yall::testing::AllocationCounter counter;
+};
+
+// Times every call on its own and reports percentiles of the latest samples
+// and the maximum of all of them. Under Threads() the samples of all threads are
+// merged, the first thread waits for the others and reports. The two clock
+// reads per call are part of the mean time of such benchmarks. Make it before
+// the AllocationCounter, the samples are allocated up front and merged after.
+class LatencyRecorder {
+public:
+  enum : size_t { capacity = 1 << 16 };
+
+  explicit LatencyRecorder(benchmark::State& state)
+    : state(state), samples(capacity), count(0), max(0) {}
+
+  ~LatencyRecorder() {
+    Merged& merged = mergedRuns();
+    std::unique_lock<std::mutex> lock(merged.mutex);
+    merged.samples.insert(merged.samples.end(), samples.begin(),
+                          samples.begin() + (count < capacity ? count : capacity));
+    merged.max = std::max(merged.max, max);
+    ++merged.threads;
+    merged.done.notify_all();
+    if (state.thread_index() != 0)
+      return;
+
+    merged.done.wait(lock, [&merged, this]() { return merged.threads == size_t(state.threads()); });
+    auto& all = merged.samples;
+    if (!all.empty()) {
+      std::sort(all.begin(), all.end());
+      report("p50_ns", all[all.size() / 2]);
+      report("p99_ns", all[all.size() * 99 / 100]);
+      report("p999_ns", all[all.size() * 999 / 1000]);
+      report("max_ns", merged.max);
+    }
+    all.clear();
+    merged.max = 0;
+    merged.threads = 0;
+  }
+
+  template <typename F>
+  void measure(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    samples[count++ & (capacity - 1)] = ns;
+    if (ns > max)
+      max = ns;
+  }
+
+private:
+  // The threads of the benchmark running at the time.
+  struct Merged {
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<long long> samples;
+    long long max = 0;
+    size_t threads = 0;
+  };
+
+  static Merged& mergedRuns() {
+    static Merged merged;
+    return merged;
+  }
+
+  // Only the first thread reports, so the value is taken as it is.
+  void report(const char* name, long long ns) {
+    state.counters[name] = benchmark::Counter(double(ns));
+  }
+
+  benchmark::State& state;
+  std::vector<long long> samples;
+  size_t count;
+  long long max;
+};
+
 static void BM_LoggerStream(benchmark::State& state) {
+  AllocationCounter allocs(state);
   auto stream = std::make_shared<std::stringstream>();
   Logger log(BackendBuilder().makeStream(stream).take());
   while (state.KeepRunning())
@@ -21,6 +126,425 @@ static void BM_LoggerStream(benchmark::State& state) {
 }
 BENCHMARK(BM_LoggerStream);
 
+static void BM_LoggerAsyncStream(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  auto stream = std::make_shared<std::stringstream>();
+  Logger log(BackendBuilder().makeStream(stream).decorate<AsyncBackend>().take());
+  while (state.KeepRunning())
+    log.log("test");
+}
+BENCHMARK(BM_LoggerAsyncStream);
+
+// Producers on all threads feeding one asynchronous backend: a shared queue
+// against per-thread buffers merged by timestamp.
+template <typename Backend>
+static void BM_LoggerThreads(benchmark::State& state) {
+  static auto backend = std::make_shared<Backend>(std::make_shared<NullBackend>());
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(backend);
+  while (state.KeepRunning())
+    latency.measure([&log]() { log.log("test"); });
+}
+BENCHMARK_TEMPLATE(BM_LoggerThreads, AsyncBackend)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_LoggerThreads, MergingBackend)->ThreadRange(1, 8)->UseRealTime();
+
+// All threads writing through one synchronous file sink and its lock.
+static void BM_LoggerThreadsFile(benchmark::State& state) {
+  static auto backend = std::make_shared<FileBackend>("/dev/null");
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(backend);
+  while (state.KeepRunning())
+    latency.measure([&log]() { log.log("test"); });
+}
+BENCHMARK(BM_LoggerThreadsFile)->ThreadRange(1, 8)->UseRealTime();
+
+// A sink that cannot keep up: blocking producers against dropping on their behalf.
+struct SlowBackend : public LoggerBackend {
+  void take(LoggerMessage&&) override {
+    std::this_thread::sleep_for(std::chrono::microseconds(20));
+  }
+};
+
+static void BM_LoggerAsyncOverflow(benchmark::State& state) {
+  OverflowPolicy policy = state.range(0) == 0 ? OverflowPolicy::block() : OverflowPolicy::dropNewest();
+  policy.reportInterval = std::chrono::milliseconds(0);
+  auto backend = std::make_shared<AsyncBackend>(std::make_shared<SlowBackend>(), 64, policy);
+  Logger log(backend);
+  while (state.KeepRunning())
+    log.log("test");
+  state.counters["dropped/msg"] = benchmark::Counter(
+    double(backend->dropped()), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_LoggerAsyncOverflow)->Arg(0)->Arg(1);
+
+static void BM_LoggerFile(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<FileBackend>("/dev/null"));
+  while (state.KeepRunning())
+    log.log("test");
+}
+BENCHMARK(BM_LoggerFile);
+
+static void BM_LoggerEagerNumbers(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    log.log("value ", 12345678, ' ', 3.14159);
+}
+BENCHMARK(BM_LoggerEagerNumbers);
+
+static void BM_LoggerDeferredNumbers(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>(), Capture::Deferred);
+  while (state.KeepRunning())
+    log.log("value ", 12345678, ' ', 3.14159);
+}
+BENCHMARK(BM_LoggerDeferredNumbers);
+
+static void BM_LoggerFmtEvaluation(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<FmtEvaluatingBackend>(std::make_shared<NullBackend>()), Capture::Deferred);
+  while (state.KeepRunning())
+    log.log(MakeFmt("value ${1} of ${2} in ${3}"), 12345678, "name", 'c');
+}
+BENCHMARK(BM_LoggerFmtEvaluation);
+
+static void BM_LoggerDisabledPriority(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  log.setThreshold(Priority::Info);
+  while (state.KeepRunning())
+    log.log(Priority::Debug, "value ", 12345678, ' ', 3.14159);
+}
+BENCHMARK(BM_LoggerDisabledPriority);
+
+static void BM_LoggerDisabledLazyDump(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  log.setThreshold(Priority::Info);
+  std::vector<int> values(1000, 42);
+  auto dump = lazy([&values]() {
+    std::string ret;
+    for (int v : values) ret += toString(v) + ' ';
+    return ret;
+  });
+  while (state.KeepRunning())
+    log.log(Priority::Debug, "values ", dump);
+}
+BENCHMARK(BM_LoggerDisabledLazyDump);
+
+// A hot site logging one occurrence in a thousand, the rest cost a counter.
+static void BM_LoggerSampledEveryN(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    YALL_LOG_EVERY_N(log, Priority::Info, 1000, "value ", 12345678, ' ', 3.14159);
+}
+BENCHMARK(BM_LoggerSampledEveryN);
+
+static void BM_LoggerSampledRate(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    YALL_LOG_RATE(log, Priority::Info, 100, "value ", 12345678, ' ', 3.14159);
+}
+BENCHMARK(BM_LoggerSampledRate);
+
+// The same line over and over (arg 0) against a new line every time (arg 1),
+// both in front of the formatting and a stream.
+static void BM_LoggerDedup(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  auto stream = std::make_shared<std::stringstream>();
+  Logger log(std::make_shared<DedupBackend>(BackendBuilder().makeStream(stream).decorate<MetaFormattingBackend>().take()),
+    Capture::Deferred);
+  int value = 0;
+  while (state.KeepRunning()) {
+    log.log(MakeFmt("connection ${1} refused"), value);
+    value += static_cast<int>(state.range(0));
+    if (stream->tellp() > (1 << 20))
+      stream->str(std::string());
+  }
+}
+BENCHMARK(BM_LoggerDedup)->Arg(0)->Arg(1);
+
+static void BM_LoggerMetaFormatting(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<PriorityDecoratingBackend>(
+    std::make_shared<MetaFormattingBackend>(std::make_shared<NullBackend>()),
+    Priority::Info));
+  while (state.KeepRunning())
+    log.log("test");
+}
+BENCHMARK(BM_LoggerMetaFormatting);
+
+static void BM_LoggerFanOut(benchmark::State& state) {
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  auto fanOut = std::make_shared<FanOutBackend>();
+  for (int i = 0; i < state.range(0); ++i)
+    fanOut->add(std::make_shared<NullBackend>());
+  Logger log(fanOut);
+  while (state.KeepRunning())
+    latency.measure([&log]() { log.log("value ", 12345678, ' ', 3.14159); });
+}
+BENCHMARK(BM_LoggerFanOut)->RangeMultiplier(2)->Range(1, 16);
+
+// The same message through the three ways of writing it.
+static void BM_CallStyleVariadic(benchmark::State& state) {
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    latency.measure([&log]() { log.log(Priority::Info, "value ", 12345678, " of ", "name"); });
+}
+BENCHMARK(BM_CallStyleVariadic);
+
+static void BM_CallStyleFmt(benchmark::State& state) {
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    latency.measure([&log]() { log.log(Priority::Info, MakeFmt("value ${1} of ${2}"), 12345678, "name"); });
+}
+BENCHMARK(BM_CallStyleFmt);
+
+static void BM_CallStyleGatherer(benchmark::State& state) {
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    latency.measure([&log]() { log(Priority::Info) << "value " << 12345678 << " of " << "name"; });
+}
+BENCHMARK(BM_CallStyleGatherer);
+
+// 1 to 8 integer arguments, eager and deferred.
+template <typename ...Args>
+static void logArgs(const Logger& log, Args... args) {
+  log.log(Priority::Info, args...);
+}
+
+static void BM_LoggerArgumentCount(benchmark::State& state) {
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>(), state.range(1) ? Capture::Deferred : Capture::Eager);
+  const long long v = 12345678;
+  while (state.KeepRunning()) {
+    latency.measure([&]() {
+      switch (state.range(0)) {
+        case 1: logArgs(log, v); break;
+        case 2: logArgs(log, v, v); break;
+        case 4: logArgs(log, v, v, v, v); break;
+        default: logArgs(log, v, v, v, v, v, v, v, v); break;
+      }
+    });
+  }
+}
+BENCHMARK(BM_LoggerArgumentCount)->ArgsProduct({{1, 2, 4, 8}, {0, 1}});
+
+// One argument of each type, eager and deferred.
+template <typename T>
+static void BM_LoggerArgumentType(benchmark::State& state, T value) {
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<NullBackend>(), state.range(0) ? Capture::Deferred : Capture::Eager);
+  while (state.KeepRunning())
+    latency.measure([&]() { log.log(Priority::Info, value); });
+}
+BENCHMARK_CAPTURE(BM_LoggerArgumentType, int, 12345678)->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LoggerArgumentType, double, 3.14159)->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LoggerArgumentType, char, 'c')->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LoggerArgumentType, literal, "literal text")->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LoggerArgumentType, string, std::string("a string longer than the SSO buffer"))->Arg(0)->Arg(1);
+BENCHMARK_CAPTURE(BM_LoggerArgumentType, priority, Priority::Warning)->Arg(0)->Arg(1);
+
+// Each backend and decorator on its own: decorators in front of a NullBackend,
+// sinks at the end of the chain, all fed the same deferred Fmt message.
+using BackendFactory = std::shared_ptr<LoggerBackend> (*)();
+
+std::shared_ptr<LoggerBackend> nullSink() {
+  return std::make_shared<NullBackend>();
+}
+
+template <typename Decorator>
+std::shared_ptr<LoggerBackend> decorating() {
+  return std::make_shared<Decorator>(nullSink());
+}
+
+std::shared_ptr<LoggerBackend> prefixing() {
+  return std::make_shared<PrefixDecoratingBackend>(nullSink(), "app");
+}
+
+std::shared_ptr<LoggerBackend> sequencePrefixing() {
+  return std::make_shared<SequencePrefixingBackend>(nullSink(), "app");
+}
+
+std::shared_ptr<LoggerBackend> prioritySetting() {
+  return std::make_shared<PriorityDecoratingBackend>(nullSink(), Priority::Info);
+}
+
+std::shared_ptr<LoggerBackend> filtering() {
+  return std::make_shared<FilteringBackend>(nullSink(), "db.* >= warning, * >= info");
+}
+
+std::shared_ptr<LoggerBackend> streamSink() {
+  return std::make_shared<StreamBackend>(std::make_shared<std::ofstream>("/dev/null"));
+}
+
+std::shared_ptr<LoggerBackend> fileSink() {
+  return std::make_shared<FileBackend>("/dev/null");
+}
+
+static void BM_Backend(benchmark::State& state, BackendFactory make) {
+  auto backend = make();
+  LatencyRecorder latency(state);
+  AllocationCounter allocs(state);
+  Logger log(backend, Capture::Deferred);
+  int value = 0;
+  while (state.KeepRunning())
+    latency.measure([&]() { log.log(Priority::Info, MakeFmt("value ${1} of ${2}"), value++, "name"); });
+}
+BENCHMARK_CAPTURE(BM_Backend, Null, &nullSink);
+BENCHMARK_CAPTURE(BM_Backend, Prefix, &prefixing);
+BENCHMARK_CAPTURE(BM_Backend, SequencePrefix, &sequencePrefixing);
+BENCHMARK_CAPTURE(BM_Backend, Priority, &prioritySetting);
+BENCHMARK_CAPTURE(BM_Backend, FmtEvaluating, &decorating<FmtEvaluatingBackend>);
+BENCHMARK_CAPTURE(BM_Backend, CaptureEvaluating, &decorating<CaptureEvaluatingBackend>);
+BENCHMARK_CAPTURE(BM_Backend, MetaFormatting, &decorating<MetaFormattingBackend>);
+BENCHMARK_CAPTURE(BM_Backend, Filtering, &filtering);
+BENCHMARK_CAPTURE(BM_Backend, Dedup, &decorating<DedupBackend>);
+BENCHMARK_CAPTURE(BM_Backend, Async, &decorating<AsyncBackend>);
+BENCHMARK_CAPTURE(BM_Backend, Merging, &decorating<MergingBackend>);
+BENCHMARK_CAPTURE(BM_Backend, Stream, &streamSink);
+BENCHMARK_CAPTURE(BM_Backend, File, &fileSink);
+
+static void BM_PrefixedLoggerChild(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  PrefixedLogger root(std::make_shared<NullBackend>());
+  while (state.KeepRunning())
+    root.child("db").child("pool").log("test");
+}
+BENCHMARK(BM_PrefixedLoggerChild);
+
+// Deciding by a deep name against a handful of rules, half of the calls dropped.
+static void BM_LoggerFiltering(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  PrefixedLogger root(std::make_shared<FilteringBackend>(std::make_shared<NullBackend>(),
+    "root.db.* >= warning, root.net.http.* >= debug, root.net >= info, * >= info"));
+  auto log = root.child("db.pool.conn");
+  bool warn = false;
+  while (state.KeepRunning()) {
+    log.log(warn ? Priority::Warning : Priority::Debug, "test");
+    warn = !warn;
+  }
+}
+BENCHMARK(BM_LoggerFiltering);
+
+static void BM_FormatInteger(benchmark::State& state) {
+  char buf[maxNumberLength];
+  long long v = -1234567890123;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(formatDecimal(v++, buf));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_FormatInteger);
+
+static void BM_FormatIntegerSnprintf(benchmark::State& state) {
+  char buf[maxNumberLength];
+  long long v = -1234567890123;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(snprintf(buf, sizeof(buf), "%lld", v++));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_FormatIntegerSnprintf);
+
+static void BM_FormatIntegerToString(benchmark::State& state) {
+  long long v = -1234567890123;
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(std::to_string(v++));
+}
+BENCHMARK(BM_FormatIntegerToString);
+
+static void BM_FormatDouble(benchmark::State& state) {
+  char buf[maxNumberLength];
+  double v = 3.14159;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(formatShortest(v, buf));
+    benchmark::ClobberMemory();
+    v += 1.1;
+  }
+}
+BENCHMARK(BM_FormatDouble);
+
+static void BM_FormatDoubleSnprintf(benchmark::State& state) {
+  char buf[maxNumberLength];
+  double v = 3.14159;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(snprintf(buf, sizeof(buf), "%.17g", v));
+    benchmark::ClobberMemory();
+    v += 1.1;
+  }
+}
+BENCHMARK(BM_FormatDoubleSnprintf);
+
+static void BM_FormatDoubleToString(benchmark::State& state) {
+  double v = 3.14159;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(std::to_string(v));
+    v += 1.1;
+  }
+}
+BENCHMARK(BM_FormatDoubleToString);
+
+static void BM_FormatHex(benchmark::State& state) {
+  char buf[maxNumberLength];
+  unsigned long long v = 0x7f3a5c2e1b00;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(formatHex(v++, buf));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_FormatHex);
+
+static void BM_FormatHexSnprintf(benchmark::State& state) {
+  char buf[maxNumberLength];
+  unsigned long long v = 0x7f3a5c2e1b00;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(snprintf(buf, sizeof(buf), "%llx", v++));
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_FormatHexSnprintf);
+
+static void BM_LoggerDecoratorChain(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(std::make_shared<PrefixDecoratingBackend>(
+    std::make_shared<PriorityDecoratingBackend>(
+      std::make_shared<FmtEvaluatingBackend>(
+        std::make_shared<MetaFormattingBackend>(std::make_shared<NullBackend>())),
+      Priority::Info),
+    "app"), Capture::Deferred);
+  while (state.KeepRunning())
+    log.log(MakeFmt("value ${1} of ${2}"), 12345678, "name");
+}
+BENCHMARK(BM_LoggerDecoratorChain);
+
+static void BM_LoggerStaticPipeline(benchmark::State& state) {
+  AllocationCounter allocs(state);
+  Logger log(makePipeline(
+    stage::Prefix("app"),
+    stage::SetPriority(Priority::Info),
+    stage::EvaluateFmt(),
+    stage::FormatMeta(),
+    stage::Null()), Capture::Deferred);
+  while (state.KeepRunning())
+    log.log(MakeFmt("value ${1} of ${2}"), 12345678, "name");
+}
+BENCHMARK(BM_LoggerStaticPipeline);
+
 static void BM_LogStream(benchmark::State& state) {
   std::stringstream stream;
   while (state.KeepRunning())
@@ -30,6 +554,27 @@ static void BM_LogStream(benchmark::State& state) {
 }
 BENCHMARK(BM_LogStream);
 
+static void BM_TimeStampLocal(benchmark::State& state) {
+  auto formatter = TimeStampFormatter::local();
+  char buf[TimeStampFormatter::length];
+  while (state.KeepRunning()) {
+    formatter.format(std::chrono::system_clock::now(), buf);
+    benchmark::DoNotOptimize(buf);
+  }
+}
+BENCHMARK(BM_TimeStampLocal);
+
+static void BM_TimeStampPutTime(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    auto t = std::chrono::system_clock::now();
+    std::time_t time = std::chrono::system_clock::to_time_t(t);
+    std::stringstream buf;
+    buf << std::put_time(std::localtime(&time), "%F %T");
+    benchmark::DoNotOptimize(buf);
+  }
+}
+BENCHMARK(BM_TimeStampPutTime);
+
 static void BM_LogSprintf(benchmark::State& state) {
   std::vector<char> buf(1024);
   size_t off = 0;
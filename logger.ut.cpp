@@ -6,6 +6,15 @@
 #include "yall/fmt.hpp"
 #include "yall/priority.hpp"
 
+namespace {
+struct Tenant;
+}
+
+namespace yall {
+template <>
+struct isLogMetaData<::Tenant> : std::true_type {};
+}
+
 namespace {
 
 struct YallLoggerShould: public ::testing::Test {
@@ -64,8 +73,8 @@ TEST_F(YallLoggerShould, ForwardToBackend2WithStream) {
 
 TEST_F(YallLoggerShould, ProvideMetaData) {
   uut("test");
-  EXPECT_EQ(1, msg.meta.count("yall::TimeStamp"));
-  EXPECT_EQ(1, msg.meta.count("yall::ThreadId"));
+  EXPECT_NE(::yall::TimeStamp(), msg.meta.timeStamp);
+  EXPECT_EQ(std::this_thread::get_id(), msg.meta.threadId);
 }
 
 TEST_F(YallLoggerShould, HandleNumbers) {
@@ -117,11 +126,215 @@ TEST_F(YallLoggerShould, HandleVariousStrings) {
   }
 }
 
+struct CopyCounting {
+  CopyCounting() = default;
+  CopyCounting(const CopyCounting&) { ++copies; }
+  static int copies;
+};
+int CopyCounting::copies = 0;
+
+std::string toString(const CopyCounting&) {
+  return "counted";
+}
+
+TEST_F(YallLoggerShould, NotCopyArguments) {
+  CopyCounting::copies = 0;
+  CopyCounting counted;
+  uut.log(counted, CopyCounting(), counted);
+  EXPECT_EQ(0, CopyCounting::copies);
+  EXPECT_EQ(3, msg.sequence.size());
+}
+
 TEST_F(YallLoggerShould, HandlePrioritySetting) {
   uut.log("test", ::yall::Priority::Debug);
   EXPECT_EQ(1, msg.sequence.size());
   EXPECT_EQ("test", msg.sequence[0].value);
-  EXPECT_EQ("debug", msg.meta["yall::Priority"]);
+  EXPECT_TRUE(msg.meta.hasPriority);
+  EXPECT_EQ(::yall::Priority::Debug, msg.meta.priority);
+}
+
+struct Tenant {
+  std::string name;
+};
+
+::yall::TypeTag typeTag(const Tenant&) {
+  static const ::yall::TypeTag tag("test::Tenant");
+  return tag;
+}
+
+std::string toString(const Tenant& t) {
+  return t.name;
+}
+
+TEST_F(YallLoggerShould, KeepUserMetaDataAside) {
+  uut.log("test", Tenant{"acme"});
+  EXPECT_EQ(1, msg.sequence.size());
+  ASSERT_EQ(1, msg.meta.user.count("test::Tenant"));
+  EXPECT_EQ("acme", *msg.meta.user.find("test::Tenant"));
+}
+
+TEST_F(YallLoggerShould, EvaluateLazyArguments) {
+  uut.log("test", ::yall::lazy([]() { return 1; }));
+  verifyCall2();
+}
+
+TEST_F(YallLoggerShould, KeepLazyUserMetaDataAside) {
+  uut.log("test", ::yall::lazy([]() { return Tenant{"acme"}; }));
+  EXPECT_EQ(1, msg.sequence.size());
+  ASSERT_EQ(1, msg.meta.user.count("test::Tenant"));
+  EXPECT_EQ("acme", *msg.meta.user.find("test::Tenant"));
+}
+
+struct YallDeferredLoggerShould: public ::testing::Test {
+  YallDeferredLoggerShould():
+    backendMock(std::make_shared<MockLoggerBackend>()),
+    uut(backendMock, ::yall::Capture::Deferred) {
+  }
+  std::shared_ptr<MockLoggerBackend> backendMock;
+  ::yall::Logger uut;
+
+  ::yall::LoggerMessage msg;
+
+  void SetUp() {
+    EXPECT_CALL(*backendMock, take(::testing::_))
+      .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+  }
+};
+
+TEST_F(YallDeferredLoggerShould, KeepArgumentsNative) {
+  uut.log("test", 1, 2.5);
+
+  ASSERT_EQ(3, msg.sequence.size());
+  EXPECT_EQ("test", msg.sequence[0].value);
+  EXPECT_EQ(::yall::CapturedValue::Kind::Signed, msg.sequence[1].captured.kind);
+  EXPECT_EQ(1, msg.sequence[1].captured.i);
+  EXPECT_EQ(::yall::CapturedValue::Kind::Floating, msg.sequence[2].captured.kind);
+  EXPECT_EQ("1", text(msg.sequence[1]));
+}
+
+TEST_F(YallDeferredLoggerShould, KeepFmtWithSegmentTable) {
+  uut.log(MakeFmt("${1}"), 10);
+
+  ASSERT_EQ(2, msg.sequence.size());
+  EXPECT_EQ("yall::Fmt", msg.sequence[0].type);
+  EXPECT_EQ(::yall::CapturedValue::Kind::Format, msg.sequence[0].captured.kind);
+  EXPECT_STREQ("${1}", msg.sequence[0].captured.format->string);
+}
+
+TEST_F(YallDeferredLoggerShould, CaptureLazyResultsNative) {
+  uut.log(MakeFmt("${1}"), ::yall::lazy([]() { return 10; }));
+
+  ASSERT_EQ(2, msg.sequence.size());
+  EXPECT_EQ(::yall::CapturedValue::Kind::Signed, msg.sequence[1].captured.kind);
+  EXPECT_EQ(10, msg.sequence[1].captured.i);
+}
+
+TEST_F(YallDeferredLoggerShould, CaptureFromStream) {
+  uut() << "Result is " << 10 << ::yall::Priority::Warning;
+
+  ASSERT_EQ(2, msg.sequence.size());
+  EXPECT_EQ(10, msg.sequence[1].captured.i);
+  EXPECT_EQ(::yall::Priority::Warning, msg.meta.priority);
+}
+
+struct YallLoggerFilteringShould: public ::testing::Test {
+  YallLoggerFilteringShould():
+    backendMock(std::make_shared<MockLoggerBackend>()),
+    uut(backendMock) {
+    uut.setThreshold(::yall::Priority::Warning);
+  }
+  std::shared_ptr<MockLoggerBackend> backendMock;
+  ::yall::Logger uut;
+
+  int evaluations = 0;
+  int expensive() {
+    return ++evaluations;
+  }
+};
+
+TEST_F(YallLoggerFilteringShould, DropBelowThresholdBeforeGathering) {
+  EXPECT_CALL(*backendMock, take(::testing::_)).Times(0);
+  uut.log(::yall::Priority::Info, "dropped");
+  uut.log(::yall::Priority::Debug, MakeFmt("${1}"), "dropped");
+  uut(::yall::Priority::Info) << "dropped";
+  uut.log<::yall::Priority::Debug>("dropped");
+}
+
+TEST_F(YallLoggerFilteringShould, ForwardAtOrAboveThreshold) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*backendMock, take(::testing::_))
+    .Times(2).WillRepeatedly(::testing::SaveArg<0>(&msg));
+  uut.log(::yall::Priority::Error, "kept");
+  EXPECT_EQ(::yall::Priority::Error, msg.meta.priority);
+  uut(::yall::Priority::Warning) << "kept";
+  EXPECT_EQ(::yall::Priority::Warning, msg.meta.priority);
+  EXPECT_EQ("kept", msg.sequence[0].value);
+}
+
+TEST_F(YallLoggerFilteringShould, TakePriorityFirstWithOperator) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*backendMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+  uut(::yall::Priority::Info, "dropped");
+  uut(::yall::Priority::Warning, "x");
+  EXPECT_EQ(::yall::Priority::Warning, msg.meta.priority);
+  EXPECT_EQ(1, msg.sequence.size());
+  EXPECT_EQ("x", msg.sequence[0].value);
+}
+
+TEST_F(YallLoggerFilteringShould, TakePriorityFirstWithFmtAndOperator) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*backendMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+  uut(::yall::Priority::Info, MakeFmt("${1}"), 1);
+  uut(::yall::Priority::Error, MakeFmt("${1}"), 2);
+  EXPECT_EQ(::yall::Priority::Error, msg.meta.priority);
+  EXPECT_EQ(2, msg.sequence.size());
+  EXPECT_EQ("${1}", msg.sequence[0].value);
+  EXPECT_EQ("2", msg.sequence[1].value);
+}
+
+TEST_F(YallLoggerFilteringShould, DropWhenPriorityIsStreamedLate) {
+  EXPECT_CALL(*backendMock, take(::testing::_)).Times(0);
+  uut() << "dropped" << ::yall::Priority::Debug;
+}
+
+TEST_F(YallLoggerFilteringShould, KeepDroppedWhenHigherPriorityIsStreamedLate) {
+  EXPECT_CALL(*backendMock, take(::testing::_)).Times(0);
+  uut(::yall::Priority::Info) << "dropped" << ::yall::Priority::Error;
+}
+
+TEST_F(YallLoggerFilteringShould, ShareThresholdWithCopies) {
+  auto copy = uut;
+  copy.setThreshold(::yall::Priority::Error);
+  EXPECT_EQ(::yall::Priority::Error, uut.getThreshold());
+  EXPECT_FALSE(uut.enabled(::yall::Priority::Warning));
+  EXPECT_TRUE(uut.enabled(::yall::Priority::Error));
+}
+
+TEST_F(YallLoggerFilteringShould, NotEvaluateArgumentsOfDisabledMacroCalls) {
+  EXPECT_CALL(*backendMock, take(::testing::_)).Times(1);
+  YALL_LOG(uut, ::yall::Priority::Debug, "value ", expensive());
+  YALL_STREAM(uut, ::yall::Priority::Info) << expensive();
+  EXPECT_EQ(0, evaluations);
+  YALL_LOG(uut, ::yall::Priority::Error, "value ", expensive());
+  EXPECT_EQ(1, evaluations);
+}
+
+TEST_F(YallLoggerFilteringShould, NotEvaluateLazyArgumentsOfDisabledCalls) {
+  ::yall::LoggerMessage msg;
+  EXPECT_CALL(*backendMock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&msg));
+  auto value = ::yall::lazy([this]() { return expensive(); });
+
+  uut.log(::yall::Priority::Debug, "value ", value);
+  uut.log(::yall::Priority::Info, MakeFmt("value ${1}"), value);
+  uut(::yall::Priority::Info) << "value " << value;
+  EXPECT_EQ(0, evaluations);
+
+  uut.log(::yall::Priority::Error, "value ", value);
+  EXPECT_EQ(1, evaluations);
+  EXPECT_EQ("1", msg.sequence[1].value);
 }
 
 }
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include "yall/merging.hpp"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace std::chrono;
+
+struct TimeStampRecorder : public ::yall::LoggerBackend {
+  void take(::yall::LoggerMessage&& msg) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    seen.push_back(msg.meta.timeStamp);
+  }
+
+  std::vector<::yall::TimeStamp> received() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return seen;
+  }
+
+  std::mutex mutex;
+  std::vector<::yall::TimeStamp> seen;
+};
+
+::yall::LoggerMessage stampedAt(::yall::TimeStamp t) {
+  ::yall::LoggerMessage msg;
+  msg.meta.timeStamp = t;
+  return msg;
+}
+
+template <typename Predicate>
+bool eventually(Predicate predicate) {
+  for (int i = 0; i < 2000 && !predicate(); ++i) {
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  return predicate();
+}
+
+struct YallMergingBackendShould : public ::testing::Test {
+  YallMergingBackendShould():
+    recorder(std::make_shared<TimeStampRecorder>()) {
+  }
+  std::shared_ptr<TimeStampRecorder> recorder;
+};
+
+TEST_F(YallMergingBackendShould, MergeThreadsInTimestampOrder) {
+  ::yall::MergingBackend uut(recorder, hours(1));
+  const auto start = system_clock::now();
+  // An idle registered thread holds everything back for the window, until flush().
+  uut.take(stampedAt(start));
+
+  const int perThread = 100;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 3; ++t) {
+    threads.emplace_back([&uut, start, t]() {
+      for (int i = 0; i < perThread; ++i) {
+        uut.take(stampedAt(start + microseconds(1 + 3 * i + t)));
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  uut.flush();
+
+  auto received = recorder->received();
+  ASSERT_EQ(size_t(1 + 3 * perThread), received.size());
+  EXPECT_TRUE(std::is_sorted(received.begin(), received.end()));
+}
+
+TEST_F(YallMergingBackendShould, DeliverOnceTheWindowPassed) {
+  ::yall::MergingBackend uut(recorder, milliseconds(5));
+  std::promise<void> done;
+  std::thread idle([&uut, &done]() {
+    uut.take(stampedAt(system_clock::now()));
+    done.get_future().wait();
+  });
+  EXPECT_TRUE(eventually([&]() { return recorder->received().size() == 1; }));
+
+  uut.take(stampedAt(system_clock::now()));
+  EXPECT_TRUE(eventually([&]() { return recorder->received().size() == 2; }));
+  done.set_value();
+  idle.join();
+}
+
+TEST_F(YallMergingBackendShould, UnregisterExitedThreads) {
+  ::yall::MergingBackend uut(recorder);
+  std::thread producer([&uut]() { uut.take(stampedAt(system_clock::now())); });
+  producer.join();
+  EXPECT_TRUE(eventually([&]() { return uut.producers() == 0; }));
+  EXPECT_EQ(1u, recorder->received().size());
+
+  uut.take(stampedAt(system_clock::now()));
+  EXPECT_EQ(1u, uut.producers());
+}
+
+TEST_F(YallMergingBackendShould, DeliverEverythingOnDestruction) {
+  std::promise<void> done;
+  std::thread idle;
+  {
+    ::yall::MergingBackend uut(recorder, hours(1), 4);
+    idle = std::thread([&uut, &done]() {
+      uut.take(stampedAt(system_clock::now()));
+      done.get_future().wait();
+    });
+    EXPECT_TRUE(eventually([&]() { return recorder->received().size() == 1; }));
+
+    // Held back for the idle thread, but a full buffer does not wait for the window.
+    for (int i = 0; i < 10; ++i) {
+      uut.take(stampedAt(system_clock::now()));
+    }
+  }
+  EXPECT_EQ(11u, recorder->received().size());
+  done.set_value();
+  idle.join();
+}
+
+}
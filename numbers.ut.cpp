@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include "yall/numbers.hpp"
+#include "yall/toString.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+template <typename T>
+std::string formatted(T t) {
+  char buf[::yall::maxNumberLength];
+  return std::string(buf, ::yall::formatNumber(t, buf));
+}
+
+std::string hex(unsigned long long v, bool upper = false) {
+  char buf[::yall::maxNumberLength];
+  return std::string(buf, ::yall::formatHex(v, buf, upper));
+}
+
+TEST(YallFormatNumberShould, FormatIntegersAroundDigitBoundaries) {
+  EXPECT_EQ("0", formatted(0));
+  EXPECT_EQ("9", formatted(9));
+  EXPECT_EQ("10", formatted(10));
+  EXPECT_EQ("99", formatted(99));
+  EXPECT_EQ("100", formatted(100));
+  EXPECT_EQ("1000", formatted(1000u));
+  EXPECT_EQ("12345", formatted(12345));
+  EXPECT_EQ("-7", formatted(-7));
+  EXPECT_EQ("-100", formatted(short(-100)));
+}
+
+TEST(YallFormatNumberShould, FormatIntegerLimits) {
+  EXPECT_EQ(std::to_string(std::numeric_limits<long long>::min()), formatted(std::numeric_limits<long long>::min()));
+  EXPECT_EQ(std::to_string(std::numeric_limits<long long>::max()), formatted(std::numeric_limits<long long>::max()));
+  EXPECT_EQ("18446744073709551615", formatted(std::numeric_limits<unsigned long long>::max()));
+  EXPECT_EQ("-128", formatted(std::numeric_limits<signed char>::min()));
+}
+
+TEST(YallFormatNumberShould, FormatHex) {
+  EXPECT_EQ("0", hex(0));
+  EXPECT_EQ("f", hex(15));
+  EXPECT_EQ("10", hex(16));
+  EXPECT_EQ("DEADBEEF", hex(0xdeadbeef, true));
+  EXPECT_EQ("ffffffffffffffff", hex(~0ull));
+}
+
+TEST(YallFormatNumberShould, PrintShortestDoubles) {
+  EXPECT_EQ("0.1", formatted(0.1));
+  EXPECT_EQ("1.5", formatted(1.5));
+  EXPECT_EQ("-2.25", formatted(-2.25));
+  EXPECT_EQ("3.14159", formatted(3.14159));
+  EXPECT_EQ("1.0", formatted(1.0));
+  EXPECT_EQ("100.0", formatted(100.0));
+  EXPECT_EQ("0.0001", formatted(0.0001));
+  EXPECT_EQ("1e-05", formatted(0.00001));
+  EXPECT_EQ("1e+21", formatted(1e21));
+  EXPECT_EQ("1.7976931348623157e+308", formatted(std::numeric_limits<double>::max()));
+  EXPECT_EQ("5e-324", formatted(std::numeric_limits<double>::denorm_min()));
+}
+
+TEST(YallFormatNumberShould, PrintShortestFloats) {
+  EXPECT_EQ("0.1", formatted(0.1f));
+  EXPECT_EQ("3.4028235e+38", formatted(std::numeric_limits<float>::max()));
+}
+
+TEST(YallFormatNumberShould, PrintSpecialValues) {
+  EXPECT_EQ("0.0", formatted(0.0));
+  EXPECT_EQ("-0.0", formatted(-0.0));
+  EXPECT_EQ("inf", formatted(std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("-inf", formatted(-std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("nan", formatted(std::numeric_limits<double>::quiet_NaN()));
+}
+
+TEST(YallFormatNumberShould, RoundTripRandomDoubles) {
+  std::mt19937_64 random(42);
+  for (int i = 0; i < 100000; ++i) {
+    unsigned long long bits = random();
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    if (!std::isfinite(d))
+      continue;
+    const auto text = formatted(d);
+    ASSERT_EQ(d, std::strtod(text.c_str(), nullptr)) << text;
+  }
+}
+
+TEST(YallFormatNumberShould, RoundTripRandomFloats) {
+  std::mt19937 random(42);
+  for (int i = 0; i < 100000; ++i) {
+    unsigned bits = random();
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    if (!std::isfinite(f))
+      continue;
+    const auto text = formatted(f);
+    ASSERT_EQ(f, std::strtof(text.c_str(), nullptr)) << text;
+  }
+}
+
+TEST(YallToStringShould, PrintThreadIdLikeStream) {
+  std::stringstream expected;
+  expected << std::hex << std::this_thread::get_id();
+  EXPECT_EQ(expected.str(), ::yall::toString(std::this_thread::get_id()));
+
+  std::stringstream none;
+  none << std::hex << std::thread::id();
+  EXPECT_EQ(none.str(), ::yall::toString(std::thread::id()));
+}
+
+}
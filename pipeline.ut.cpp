@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include "yall/pipeline.hpp"
+#include "yall/mocks.hpp"
+
+#include <sstream>
+
+namespace {
+
+struct YallPipelineShould: public ::testing::Test {
+  ::yall::LoggerMessage message() {
+    ::yall::LoggerMessage msg;
+    msg.meta.timeStamp = ::yall::TimeStamp(std::chrono::milliseconds(1234567891500));
+    msg.meta.threadId = std::this_thread::get_id();
+    msg.sequence.emplace_back(::yall::TypeAndValue{"yall::Fmt", "${1}-${2}"});
+    msg.sequence.emplace_back(::yall::TypeAndValue{"test", "one"});
+    msg.sequence.emplace_back();
+    capture(msg.sequence.back(), 2);
+    return msg;
+  }
+};
+
+TEST_F(YallPipelineShould, WriteWhatTheDecoratorChainWrites) {
+  auto dynamicOut = std::make_shared<std::stringstream>();
+  auto chain = std::make_shared<::yall::PrefixDecoratingBackend>(
+    std::make_shared<::yall::PriorityDecoratingBackend>(
+      std::make_shared<::yall::FmtEvaluatingBackend>(
+        std::make_shared<::yall::MetaFormattingBackend>(
+          std::make_shared<::yall::StreamBackend>(dynamicOut),
+          ::yall::TimeStampFormatter::utc())),
+      ::yall::Priority::Info),
+    "app");
+
+  auto staticOut = std::make_shared<std::stringstream>();
+  auto pipeline = ::yall::makePipeline(
+    ::yall::stage::Prefix("app"),
+    ::yall::stage::SetPriority(::yall::Priority::Info),
+    ::yall::stage::EvaluateFmt(),
+    ::yall::stage::FormatMeta(::yall::Layout::defaultPattern(), ::yall::TimeStampFormatter::utc()),
+    ::yall::stage::Stream(staticOut));
+
+  chain->take(message());
+  pipeline->take(message());
+
+  EXPECT_THAT(staticOut->str(), ::testing::EndsWith("    info -app- one-2\n"));
+  EXPECT_EQ(dynamicOut->str(), staticOut->str());
+}
+
+TEST_F(YallPipelineShould, AcceptAnyCallableAsStage) {
+  int seen = 0;
+  auto pipeline = ::yall::makePipeline(
+    [&seen](::yall::LoggerMessage& msg) { seen = msg.sequence.size(); },
+    ::yall::stage::Null());
+
+  pipeline->take(message());
+
+  EXPECT_EQ(3, seen);
+}
+
+TEST_F(YallPipelineShould, ForwardToRuntimeChain) {
+  auto mock = std::make_shared<MockLoggerBackend>();
+  ::yall::LoggerMessage received;
+  EXPECT_CALL(*mock, take(::testing::_))
+    .Times(1).WillOnce(::testing::SaveArg<0>(&received));
+
+  ::yall::Pipeline<::yall::stage::EvaluateFmt, ::yall::stage::Forward> pipeline{
+    ::yall::stage::EvaluateFmt(), ::yall::stage::Forward(mock)};
+  auto msg = message();
+  pipeline(msg);
+
+  ASSERT_EQ(1, received.sequence.size());
+  EXPECT_EQ("one-2", received.sequence[0].value);
+}
+
+}
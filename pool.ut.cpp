@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "yall/pool.hpp"
+
+#include <thread>
+
+namespace {
+
+::yall::LoggerMessage withFields(size_t n) {
+  ::yall::LoggerMessage msg;
+  for (size_t i = 0; i < n; ++i) {
+    msg.sequence.emplace_back(::yall::TypeAndValue{"test", "value"});
+  }
+  return msg;
+}
+
+TEST(YallMessagePoolShould, HandOutEmptyMessagesKeepingCapacity) {
+  auto msg = withFields(::yall::LoggerMessage::TypeAndValueSequence::inlineCapacity + 1);
+  msg.meta.setPriority(::yall::Priority::Error);
+  auto capacity = msg.sequence.capacity();
+  ::yall::MessagePool::release(std::move(msg));
+
+  auto recycled = ::yall::MessagePool::acquire();
+  EXPECT_TRUE(recycled.sequence.empty());
+  EXPECT_FALSE(recycled.meta.hasPriority);
+  EXPECT_EQ(capacity, recycled.sequence.capacity());
+}
+
+TEST(YallMessagePoolShould, IgnoreMessagesWithoutStorage) {
+  ::yall::MessagePool::release(withFields(3));
+  ::yall::MessagePool::release(::yall::LoggerMessage());
+  EXPECT_LE(3, ::yall::MessagePool::acquire().sequence.capacity());
+}
+
+TEST(YallMessagePoolShould, NotKeepInlineMessages) {
+  ::yall::MessagePool::release(withFields(::yall::LoggerMessage::TypeAndValueSequence::inlineCapacity + 1));
+  ::yall::MessagePool::release(withFields(3));
+  EXPECT_TRUE(::yall::MessagePool::acquire().sequence.onHeap());
+}
+
+TEST(YallMessagePoolShould, NotKeepOversizedMessages) {
+  ::yall::MessagePool::release(withFields(::yall::MessagePool::maxRecycledFields + 1));
+  EXPECT_GE(::yall::MessagePool::maxRecycledFields, ::yall::MessagePool::acquire().sequence.capacity());
+}
+
+TEST(YallMessagePoolShould, ReturnMessagesReleasedOnOtherThreads) {
+  std::thread consumer([]() {
+    for (int i = 0; i < 4 * int(::yall::MessagePool::batchSize); ++i) {
+      ::yall::MessagePool::release(withFields(12));
+    }
+  });
+  consumer.join();
+
+  std::thread producer([]() {
+    auto msg = ::yall::MessagePool::acquire();
+    EXPECT_LE(12, msg.sequence.capacity());
+  });
+  producer.join();
+}
+
+struct UsesPoolAtExit {
+  ~UsesPoolAtExit() {
+    ::yall::MessagePool::release(withFields(::yall::LoggerMessage::TypeAndValueSequence::inlineCapacity + 1));
+    released = true;
+    EXPECT_TRUE(::yall::MessagePool::acquire().sequence.empty());
+  }
+  static bool released;
+};
+bool UsesPoolAtExit::released = false;
+
+TEST(YallMessagePoolShould, WorkAfterTheThreadCacheIsDestroyed) {
+  std::thread exiting([]() {
+    // Constructed before the cache, so destroyed after it.
+    thread_local UsesPoolAtExit user;
+    (void)user;
+    ::yall::MessagePool::release(withFields(::yall::LoggerMessage::TypeAndValueSequence::inlineCapacity + 1));
+  });
+  exiting.join();
+  EXPECT_TRUE(UsesPoolAtExit::released);
+}
+
+}
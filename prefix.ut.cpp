@@ -27,7 +27,7 @@ namespace {
 
     EXPECT_EQ(1, msg.sequence.size());
     EXPECT_EQ("test value", msg.sequence[0].value);
-    EXPECT_THAT(msg.meta["yall::Prefix"], "testPrefix");
+    EXPECT_EQ("testPrefix", *msg.meta.prefix);
   }
 
   TEST_F(YallPrefixDecoratingBackendShould, ProvideChildWithExtendedPrefix) {
@@ -42,7 +42,14 @@ namespace {
 
     EXPECT_EQ(1, msg.sequence.size());
     EXPECT_EQ("test value", msg.sequence[0].value);
-    EXPECT_THAT(msg.meta["yall::Prefix"], "testPrefix.ch");
+    EXPECT_EQ("testPrefix.ch", *msg.meta.prefix);
+  }
+
+  TEST(YallInternPrefixShould, ReturnTheSameStorageForEqualPrefixes) {
+    auto first = ::yall::internPrefix("a.b");
+    EXPECT_EQ(first, ::yall::internPrefix(std::string("a.") + "b"));
+    EXPECT_NE(first, ::yall::internPrefix("a.c"));
+    EXPECT_EQ("a.b", *first);
   }
 
   struct YallPrefixedLoggerShould: public ::testing::Test {
@@ -63,7 +70,7 @@ namespace {
 
     EXPECT_EQ(1, msg.sequence.size());
     EXPECT_EQ("test", msg.sequence[0].value);
-    EXPECT_THAT(msg.meta["yall::Prefix"], "root");
+    EXPECT_EQ("root", *msg.meta.prefix);
   }
 
   TEST_F(YallPrefixedLoggerShould, AllowToGetChild) {
@@ -75,9 +82,67 @@ namespace {
 
     EXPECT_EQ(1, msg.sequence.size());
     EXPECT_EQ("test", msg.sequence[0].value);
-    EXPECT_THAT(msg.meta["yall::Prefix"], "root.child");
+    EXPECT_EQ("root.child", *msg.meta.prefix);
   }
 
+  TEST_F(YallPrefixedLoggerShould, FindTheSameNodeForTheSamePath) {
+    auto& node = uut.child("tree").child("db").getNode();
+    EXPECT_EQ(&node, &uut.child("tree.db").getNode());
+    EXPECT_EQ(&node, &::yall::LoggerNode::root().child("tree").child("db"));
+    EXPECT_EQ("root.tree.db", node.name());
+    EXPECT_EQ(&uut.child("tree").getNode(), node.parent());
+    EXPECT_THROW(uut.child("tree..db"), std::invalid_argument);
+  }
 
-}
+  TEST_F(YallPrefixedLoggerShould, InheritThresholdsFromParents) {
+    auto parent = uut.child("levels");
+    auto child = parent.child("child");
+    auto grandChild = child.child("grandChild");
+
+    parent.setThreshold(::yall::Priority::Warning);
+    EXPECT_FALSE(child.enabled(::yall::Priority::Info));
+    EXPECT_FALSE(grandChild.enabled(::yall::Priority::Info));
+
+    child.setThreshold(::yall::Priority::Debug);
+    parent.setThreshold(::yall::Priority::Error);
+    EXPECT_FALSE(parent.enabled(::yall::Priority::Warning));
+    EXPECT_TRUE(grandChild.enabled(::yall::Priority::Debug));
+
+    child.resetThreshold();
+    EXPECT_FALSE(grandChild.enabled(::yall::Priority::Warning));
+    EXPECT_EQ(::yall::Priority::Error, uut.child("levels.child.later").getNode().getThreshold());
+
+    parent.resetThreshold();
+    EXPECT_TRUE(grandChild.enabled(::yall::Priority::Debug));
+  }
 
+  TEST_F(YallPrefixedLoggerShould, SetNodeThresholdThroughLoggerBase) {
+    auto parent = uut.child("base");
+    auto child = parent.child("child");
+    ::yall::Logger& base = child;
+    ::yall::Logger sliced = child.child("grandChild");
+
+    base.setThreshold(::yall::Priority::Warning);
+    EXPECT_FALSE(sliced.enabled(::yall::Priority::Info));
+    parent.setThreshold(::yall::Priority::Debug);
+    EXPECT_FALSE(child.enabled(::yall::Priority::Info));
+
+    sliced.setThreshold(::yall::Priority::Error);
+    EXPECT_EQ(::yall::Priority::Error, uut.child("base.child.grandChild.later").getNode().getThreshold());
+
+    uut.child("base.child.grandChild").resetThreshold();
+    child.resetThreshold();
+    parent.resetThreshold();
+  }
+
+  TEST_F(YallPrefixedLoggerShould, FollowThresholdChangesOfExistingHandles) {
+    auto handle = uut.child("runtime");
+    EXPECT_CALL(*decoratedMock, take(::testing::_)).Times(1);
+
+    handle.log(::yall::Priority::Info, "passes");
+    ::yall::LoggerNode::root().child("runtime").setThreshold(::yall::Priority::Error);
+    handle.log(::yall::Priority::Info, "dropped");
+    handle.resetThreshold();
+  }
+
+}
@@ -19,7 +19,7 @@ TEST_F(YallPriorityDecoratingBackendShould, ForwardToDecoratedWithNewPriority) {
   msg.sequence.emplace_back(yall::TypeAndValue{"test", "test"});
 
   auto expected = msg;
-  expected.meta["yall::Priority"] = "info";
+  expected.meta.setPriority(::yall::Priority::Info);
 
   EXPECT_CALL(*decoratedMock, take(expected)).Times(1);
   uut.take(::yall::LoggerMessage(msg));
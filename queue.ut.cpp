@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "yall/queue.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct YallBoundedQueueShould: public ::testing::Test {
+  YallBoundedQueueShould():
+    uut(4) {
+  }
+  ::yall::detail::BoundedQueue<int> uut;
+};
+
+TEST_F(YallBoundedQueueShould, RoundCapacityUpToPowerOfTwo) {
+  ::yall::detail::BoundedQueue<int> odd(5);
+  EXPECT_EQ(8, odd.capacity());
+  EXPECT_EQ(4, uut.capacity());
+}
+
+TEST_F(YallBoundedQueueShould, PopInPushOrder) {
+  EXPECT_TRUE(uut.tryPush(1));
+  EXPECT_TRUE(uut.tryPush(2));
+
+  int v = 0;
+  EXPECT_TRUE(uut.tryPop(v));
+  EXPECT_EQ(1, v);
+  EXPECT_TRUE(uut.tryPop(v));
+  EXPECT_EQ(2, v);
+  EXPECT_FALSE(uut.tryPop(v));
+  EXPECT_TRUE(uut.empty());
+}
+
+TEST_F(YallBoundedQueueShould, RejectPushWhenFull) {
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(uut.tryPush(int(i)));
+  }
+  EXPECT_FALSE(uut.tryPush(4));
+
+  int v = 0;
+  EXPECT_TRUE(uut.tryPop(v));
+  EXPECT_TRUE(uut.tryPush(4));
+  EXPECT_EQ(5, uut.enqueued());
+}
+
+TEST_F(YallBoundedQueueShould, DeliverEverythingFromManyProducers) {
+  const int producers = 4;
+  const int perProducer = 2000;
+  ::yall::detail::BoundedQueue<int> queue(64);
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&queue, p, perProducer]() {
+      for (int i = 0; i < perProducer; ++i) {
+        while (!queue.tryPush(p * perProducer + i)) std::this_thread::yield();
+      }
+    });
+  }
+
+  std::vector<int> lastSeen(producers, -1);
+  int received = 0;
+  while (received < producers * perProducer) {
+    int v;
+    if (!queue.tryPop(v)) continue;
+    int p = v / perProducer;
+    EXPECT_LT(lastSeen[p], v % perProducer);
+    lastSeen[p] = v % perProducer;
+    ++received;
+  }
+
+  for (auto& t : threads) t.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(YallSpscRingShould, PeekBeforePopAndRejectPushWhenFull) {
+  ::yall::detail::SpscRing<int> uut(2);
+  EXPECT_EQ(nullptr, uut.front());
+  EXPECT_TRUE(uut.tryPush(1));
+  EXPECT_TRUE(uut.tryPush(2));
+  EXPECT_FALSE(uut.tryPush(3));
+
+  ASSERT_NE(nullptr, uut.front());
+  EXPECT_EQ(1, *uut.front());
+  EXPECT_EQ(1, *uut.front());
+  uut.pop();
+  EXPECT_TRUE(uut.tryPush(3));
+  EXPECT_EQ(3u, uut.pushed());
+  EXPECT_EQ(2, *uut.front());
+}
+
+TEST(YallSpscRingShould, DeliverInOrderAcrossThreads) {
+  const int count = 20000;
+  ::yall::detail::SpscRing<int> ring(16);
+
+  std::thread producer([&ring, count]() {
+    for (int i = 0; i < count; ++i) {
+      while (!ring.tryPush(int(i))) std::this_thread::yield();
+    }
+  });
+
+  int expected = 0;
+  while (expected < count) {
+    int* v = ring.front();
+    if (!v) {
+      std::this_thread::yield();
+      continue;
+    }
+    EXPECT_EQ(expected, *v);
+    ring.pop();
+    ++expected;
+  }
+
+  producer.join();
+  EXPECT_TRUE(ring.empty());
+}
+
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "yall/sampling.hpp"
+#include "yall/mocks.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct YallSampledLoggingShould: public ::testing::Test {
+  YallSampledLoggingShould():
+    backendMock(std::make_shared<MockLoggerBackend>()),
+    uut(backendMock) {
+    EXPECT_CALL(*backendMock, take(::testing::_))
+      .WillRepeatedly(::testing::Invoke([this](::yall::LoggerMessage& msg) {
+        std::string text;
+        for (const auto& tv : msg.sequence)
+          text += tv.value;
+        logged.push_back(text);
+      }));
+  }
+
+  int expensive(int i) {
+    ++evaluations;
+    return i;
+  }
+
+  std::shared_ptr<MockLoggerBackend> backendMock;
+  ::yall::Logger uut;
+  std::vector<std::string> logged;
+  int evaluations = 0;
+};
+
+TEST_F(YallSampledLoggingShould, LogEveryNthOccurrenceAndReportTheSuppressed) {
+  int line = 0;
+  for (int i = 0; i < 5; ++i) {
+    line = __LINE__; YALL_LOG_EVERY_N(uut, ::yall::Priority::Info, 3, "value ", expensive(i));
+  }
+
+  const std::string site = std::string(__FILE__) + ':' + std::to_string(line);
+  EXPECT_EQ((std::vector<std::string>{"value 0", "suppressed 2 messages at " + site, "value 3"}), logged);
+  EXPECT_EQ(2, evaluations);
+}
+
+TEST_F(YallSampledLoggingShould, GoQuietAfterTheFirstN) {
+  for (int i = 0; i < 5; ++i)
+    YALL_STREAM_FIRST_N(uut, ::yall::Priority::Info, 2) << "value " << expensive(i);
+
+  EXPECT_EQ((std::vector<std::string>{"value 0", "value 1"}), logged);
+  EXPECT_EQ(2, evaluations);
+}
+
+TEST_F(YallSampledLoggingShould, LimitTheRateOfASite) {
+  for (int i = 0; i < 10; ++i)
+    YALL_LOG_RATE(uut, ::yall::Priority::Info, 3, "value ", i);
+
+  EXPECT_EQ((std::vector<std::string>{"value 0", "value 1", "value 2"}), logged);
+}
+
+TEST_F(YallSampledLoggingShould, NotCountDisabledPriorities) {
+  uut.setThreshold(::yall::Priority::Warning);
+  for (int i = 0; i < 4; ++i) {
+    YALL_LOG_EVERY_N(uut, ::yall::Priority::Info, 2, "dropped");
+    YALL_LOG_EVERY_N(uut, ::yall::Priority::Error, 2, "value ", i);
+  }
+
+  EXPECT_EQ(3, logged.size());
+  EXPECT_EQ("value 2", logged.back());
+}
+
+TEST(YallSampleShould, RefillTheTokenBucketOverTime) {
+  ::yall::sample::RateLimit uut(1000);
+  int admitted = 0;
+  while (uut.admit())
+    ++admitted;
+  EXPECT_GE(admitted, 1000);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_TRUE(uut.admit());
+  EXPECT_THROW(::yall::sample::RateLimit(0), std::invalid_argument);
+  EXPECT_THROW(::yall::sample::EveryN(0), std::invalid_argument);
+}
+
+}
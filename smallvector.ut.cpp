@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "yall/smallvector.hpp"
+
+#include <string>
+
+namespace {
+
+using Strings = ::yall::SmallVector<std::string, 2>;
+
+Strings withValues(std::initializer_list<const char*> values) {
+  Strings ret;
+  for (auto v : values) {
+    ret.emplace_back(v);
+  }
+  return ret;
+}
+
+TEST(YallSmallVectorShould, KeepFewElementsInline) {
+  auto uut = withValues({"a", "b"});
+  EXPECT_FALSE(uut.onHeap());
+  EXPECT_EQ(2u, uut.capacity());
+  EXPECT_EQ("a", uut.front());
+  EXPECT_EQ("b", uut.back());
+}
+
+TEST(YallSmallVectorShould, SpillToTheHeapKeepingTheElements) {
+  auto uut = withValues({"a", "b", "c"});
+  EXPECT_TRUE(uut.onHeap());
+  EXPECT_LE(3u, uut.capacity());
+  EXPECT_EQ(withValues({"a", "b", "c"}), uut);
+
+  uut.clear();
+  EXPECT_TRUE(uut.empty());
+  EXPECT_TRUE(uut.onHeap());
+}
+
+TEST(YallSmallVectorShould, AppendOwnElementWhenGrowing) {
+  auto uut = withValues({"a", "b"});
+  uut.push_back(uut[0]);
+  uut.emplace_back(uut.back());
+  EXPECT_EQ(withValues({"a", "b", "a", "a"}), uut);
+}
+
+TEST(YallSmallVectorShould, InsertAtTheFront) {
+  auto uut = withValues({"b", "c"});
+  uut.insert(uut.begin(), std::string("a"));
+  EXPECT_EQ(withValues({"a", "b", "c"}), uut);
+}
+
+TEST(YallSmallVectorShould, StealHeapBufferOnMove) {
+  auto source = withValues({"a", "b", "c"});
+  const auto* data = source.data();
+
+  Strings uut(std::move(source));
+  EXPECT_EQ(data, uut.data());
+  EXPECT_TRUE(source.empty());
+  EXPECT_FALSE(source.onHeap());
+
+  source = std::move(uut);
+  EXPECT_EQ(data, source.data());
+}
+
+TEST(YallSmallVectorShould, MoveInlineElements) {
+  auto source = withValues({"a"});
+  auto uut = withValues({"x", "y", "z"});
+  uut = std::move(source);
+  EXPECT_EQ(withValues({"a"}), uut);
+  EXPECT_TRUE(source.empty());
+}
+
+TEST(YallSmallVectorShould, CopyElements) {
+  auto source = withValues({"a", "b", "c"});
+  Strings uut(source);
+  EXPECT_EQ(source, uut);
+  EXPECT_NE(source.data(), uut.data());
+
+  uut = withValues({"x"});
+  uut = source;
+  EXPECT_EQ(source, uut);
+}
+
+}
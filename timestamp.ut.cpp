@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "yall/timestamp.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+struct YallTimeStampFormatterShould: public ::testing::Test {
+  static ::yall::TimeStamp at(long long millis) {
+    return ::yall::TimeStamp(std::chrono::milliseconds(millis));
+  }
+};
+
+TEST_F(YallTimeStampFormatterShould, FormatUtc) {
+  auto uut = ::yall::TimeStampFormatter::utc();
+  EXPECT_EQ("1970-01-01 00:00:00.000", uut(at(0)));
+  EXPECT_EQ("2009-02-13 23:31:30.123", uut(at(1234567890123)));
+  EXPECT_EQ("2000-02-29 12:00:00.007", uut(at(951825600007)));
+}
+
+TEST_F(YallTimeStampFormatterShould, HandleTimesBeforeEpoch) {
+  auto uut = ::yall::TimeStampFormatter::utc();
+  EXPECT_EQ("1969-12-31 23:59:59.999", uut(at(-1)));
+}
+
+TEST_F(YallTimeStampFormatterShould, ApplyFixedOffset) {
+  auto uut = ::yall::TimeStampFormatter::withOffset(std::chrono::hours(-5));
+  EXPECT_EQ("2009-02-13 18:31:30.123", uut(at(1234567890123)));
+}
+
+TEST_F(YallTimeStampFormatterShould, RebuildCachedPrefixWhenSecondChanges) {
+  auto uut = ::yall::TimeStampFormatter::utc();
+  EXPECT_EQ("2009-02-13 23:31:30.999", uut(at(1234567890999)));
+  EXPECT_EQ("2009-02-13 23:31:31.000", uut(at(1234567891000)));
+  EXPECT_EQ("2009-02-13 23:31:31.500", uut(at(1234567891500)));
+}
+
+TEST_F(YallTimeStampFormatterShould, NotMixCachesOfDifferentModes) {
+  auto utc = ::yall::TimeStampFormatter::utc();
+  auto plusOne = ::yall::TimeStampFormatter::withOffset(std::chrono::hours(1));
+  EXPECT_EQ("1970-01-01 00:00:00.000", utc(at(0)));
+  EXPECT_EQ("1970-01-01 01:00:00.000", plusOne(at(0)));
+  EXPECT_EQ("1970-01-01 00:00:00.000", utc(at(0)));
+}
+
+TEST_F(YallTimeStampFormatterShould, MatchPutTimeForLocalTime) {
+  auto now = std::chrono::system_clock::now();
+  std::time_t time = std::chrono::system_clock::to_time_t(now);
+  std::tm tm;
+  localtime_r(&time, &tm);
+  std::stringstream expected;
+  expected << std::put_time(&tm, "%F %T");
+
+  auto formatted = ::yall::TimeStampFormatter::local()(now);
+  EXPECT_EQ(expected.str(), formatted.substr(0, 19));
+  EXPECT_EQ(size_t(::yall::TimeStampFormatter::length), formatted.size());
+}
+
+TEST_F(YallTimeStampFormatterShould, AppendToExistingText) {
+  std::string out = "at ";
+  ::yall::TimeStampFormatter::utc().append(out, at(0));
+  EXPECT_EQ("at 1970-01-01 00:00:00.000", out);
+}
+
+}
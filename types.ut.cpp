@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "yall/types.hpp"
+#include "yall/toString.hpp"
+#include "yall/fmt.hpp"
+
+namespace {
+
+TEST(YallTypeTagShould, BeEqualForEqualNames) {
+  ::yall::TypeTag first("test::Tag");
+  ::yall::TypeTag second(std::string("test::") + "Tag");
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(first.id(), second.id());
+  EXPECT_NE(first, ::yall::TypeTag("test::Other"));
+}
+
+TEST(YallTypeTagShould, CompareWithNames) {
+  EXPECT_TRUE(::yall::tags::fmt() == "yall::Fmt");
+  EXPECT_TRUE("yall::Formatted" == ::yall::tags::formatted());
+  EXPECT_EQ("yall::Prefix", ::yall::tags::prefix().name());
+}
+
+TEST(YallTypeTagShould, BeStablePerType) {
+  EXPECT_EQ(::yall::typeTag(1), ::yall::typeTag(2));
+  EXPECT_NE(::yall::typeTag(1), ::yall::typeTag(1.0));
+  EXPECT_EQ(typeid(int).name(), ::yall::typeTag(1).name());
+  EXPECT_EQ(::yall::tags::fmt(), typeTag(MakeFmt("${1}")));
+}
+
+struct Legacy {};
+
+std::string typeString(const Legacy&) {
+  return "test::Legacy";
+}
+
+TEST(YallTypeTagShould, TakeNamesFromTypeStringOverloads) {
+  EXPECT_EQ("test::Legacy", ::yall::typeTag(Legacy{}).name());
+}
+
+TEST(YallTypeTagShould, DefaultToEmptyName) {
+  EXPECT_EQ("", ::yall::TypeTag().name());
+  EXPECT_EQ(::yall::TypeTag(), ::yall::TypeTag(""));
+}
+
+}